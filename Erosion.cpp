@@ -0,0 +1,435 @@
+#include "Erosion.h"
+#include "Parallel.h"
+#include <math.h>
+#include <random>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <xmmintrin.h>
+
+// A cell the erosion brush covers, relative to the droplet's cell
+struct BrushCell
+{
+	int x;
+	int y;
+	float weight;
+};
+
+// Works out the cells within radius, weighted so that cells closer to the middle are eroded more
+static std::vector<BrushCell> MakeBrush(int radius)
+{
+	std::vector<BrushCell> brush;
+	float weightSum = 0.0f;
+
+	for (int y = -radius; y <= radius; y++)
+	{
+		for (int x = -radius; x <= radius; x++)
+		{
+			float dist = sqrtf((float)(x * x + y * y));
+			if (dist < radius)
+			{
+				BrushCell cell;
+				cell.x = x;
+				cell.y = y;
+				cell.weight = 1.0f - dist / radius;
+
+				weightSum += cell.weight;
+				brush.push_back(cell);
+			}
+		}
+	}
+
+	for (int i = 0; i < brush.size(); i++)
+	{
+		brush[i].weight /= weightSum;
+	}
+
+	return brush;
+}
+
+// Wraps a cell index that has gone past either edge back onto the map
+static inline int WrapCell(int i, int size)
+{
+	return (i % size + size) % size;
+}
+
+// Droplets on a flat map never move, and NaN or infinite heights would send them anywhere, so those maps aren't eroded
+static bool CanErode(float** map, int xSize, int ySize)
+{
+	float first = map[0][0];
+	bool flat = true;
+
+	for (int y = 0; y < ySize; y++)
+	{
+		for (int x = 0; x < xSize; x++)
+		{
+			if (!isfinite(map[y][x]))
+			{
+				return false;
+			}
+			if (map[y][x] != first)
+			{
+				flat = false;
+			}
+		}
+	}
+
+	return !flat;
+}
+
+// Gets the height and the gradient at (x, y) by interpolating the four surrounding cells
+// When tiling, the cells past the last row and column are the first ones
+static float HeightAndGradient(float** map, int xSize, int ySize, int tileable, float x, float y, float& gradX, float& gradY)
+{
+	int cellX = (int)x;
+	int cellY = (int)y;
+	float u = x - cellX;
+	float v = y - cellY;
+
+	int nextX = (tileable == 1 && cellX + 1 == xSize) ? 0 : cellX + 1;
+	int nextY = (tileable == 1 && cellY + 1 == ySize) ? 0 : cellY + 1;
+
+	float h00 = map[cellY][cellX];
+	float h10 = map[cellY][nextX];
+	float h01 = map[nextY][cellX];
+	float h11 = map[nextY][nextX];
+
+	gradX = (h10 - h00) * (1 - v) + (h11 - h01) * v;
+	gradY = (h01 - h00) * (1 - u) + (h11 - h10) * u;
+
+	return h00 * (1 - u) * (1 - v) + h10 * u * (1 - v) + h01 * (1 - u) * v + h11 * u * v;
+}
+
+// Runs a single droplet from (x, y) until it evaporates, stops or leaves the map
+// When tiling it can't leave the map, it comes back on at the other side
+static void RunDroplet(float** map, int xSize, int ySize, float x, float y, const ErosionSettings& s, const std::vector<BrushCell>& brush)
+{
+	int tileable = s.tileable;
+
+	float dirX = 0.0f;
+	float dirY = 0.0f;
+	float speed = s.startSpeed;
+	float water = s.startWater;
+	float sediment = 0.0f;
+
+	for (int life = 0; life < s.maxLifetime; life++)
+	{
+		int cellX = (int)x;
+		int cellY = (int)y;
+		float u = x - cellX;
+		float v = y - cellY;
+		int nextX = (tileable == 1 && cellX + 1 == xSize) ? 0 : cellX + 1;
+		int nextY = (tileable == 1 && cellY + 1 == ySize) ? 0 : cellY + 1;
+
+		float gradX, gradY;
+		float height = HeightAndGradient(map, xSize, ySize, tileable, x, y, gradX, gradY);
+
+		// Flows downhill, keeping some of its old direction
+		dirX = dirX * s.inertia - gradX * (1 - s.inertia);
+		dirY = dirY * s.inertia - gradY * (1 - s.inertia);
+
+		float length = sqrtf(dirX * dirX + dirY * dirY);
+		if (length == 0.0f)
+		{
+			break;
+		}
+
+		// Moves exactly one cell, so a droplet never goes further than maxLifetime cells
+		dirX /= length;
+		dirY /= length;
+		x += dirX;
+		y += dirY;
+
+		if (tileable == 1)
+		{
+			// It moves at most one cell, so one map width brings it back on
+			if (x < 0)
+			{
+				x += xSize;
+			}
+			else if (x >= xSize)
+			{
+				x -= xSize;
+			}
+			if (y < 0)
+			{
+				y += ySize;
+			}
+			else if (y >= ySize)
+			{
+				y -= ySize;
+			}
+
+			if (!(x >= 0 && y >= 0 && x < xSize && y < ySize))
+			{
+				break;
+			}
+		}
+		// Written so that NaN fails it too, rather than going on to read wherever (int)NaN points
+		else if (!(x >= 0 && y >= 0 && x < xSize - 1 && y < ySize - 1))
+		{
+			break;
+		}
+
+		float newGradX, newGradY;
+		float deltaHeight = HeightAndGradient(map, xSize, ySize, tileable, x, y, newGradX, newGradY) - height;
+
+		// Faster droplets with more water on steeper slopes carry more sediment
+		float slope = -deltaHeight;
+		if (slope < s.minSlope)
+		{
+			slope = s.minSlope;
+		}
+		float capacity = slope * speed * water * s.capacity;
+
+		if (sediment > capacity || deltaHeight > 0)
+		{
+			// Going uphill fills the pit behind it, otherwise drops the sediment it can't carry
+			float amount = (deltaHeight > 0) ? fminf(deltaHeight, sediment) : (sediment - capacity) * s.depositSpeed;
+			sediment -= amount;
+
+			map[cellY][cellX] += amount * (1 - u) * (1 - v);
+			map[cellY][nextX] += amount * u * (1 - v);
+			map[nextY][cellX] += amount * (1 - u) * v;
+			map[nextY][nextX] += amount * u * v;
+		}
+		else
+		{
+			// Erodes over the brush, never digging deeper than the slope it went down
+			float amount = fminf((capacity - sediment) * s.erodeSpeed, -deltaHeight);
+
+			for (int i = 0; i < brush.size(); i++)
+			{
+				int brushX = cellX + brush[i].x;
+				int brushY = cellY + brush[i].y;
+
+				if (tileable == 1)
+				{
+					brushX = WrapCell(brushX, xSize);
+					brushY = WrapCell(brushY, ySize);
+				}
+
+				if (brushX >= 0 && brushY >= 0 && brushX < xSize && brushY < ySize)
+				{
+					float eroded = fminf(amount * brush[i].weight, map[brushY][brushX]);
+					map[brushY][brushX] -= eroded;
+					sediment += eroded;
+				}
+			}
+		}
+
+		speed = sqrtf(fmaxf(0.0f, speed * speed + deltaHeight * s.gravity));
+		water *= (1 - s.evaporateSpeed);
+	}
+}
+
+void HydraulicErosion(float** map, int xSize, int ySize, const ErosionSettings& settings)
+{
+	if (!CanErode(map, xSize, ySize))
+	{
+		return;
+	}
+
+	std::vector<BrushCell> brush = MakeBrush(settings.radius);
+
+	// A droplet can't get further than its lifetime from where it started, plus the brush and the cell it reads past itself
+	// Tiles are twice that wide, and are run in four passes (2 by 2), so tiles running at once never touch the same cells
+	int reach = settings.maxLifetime + settings.radius + 2;
+	int tileWidth = reach * 2;
+	int tileHeight = reach * 2;
+
+	int xTiles = (xSize + tileWidth - 1) / tileWidth;
+	int yTiles = (ySize + tileHeight - 1) / tileHeight;
+
+	// When tiling, droplets cross from the last tiles to the first, so those have to be in different passes too
+	// An even number of tiles each way, each at least tileSize wide, keeps them apart
+	if (settings.tileable == 1)
+	{
+		xTiles = std::max(1, xSize / tileWidth);
+		yTiles = std::max(1, ySize / tileHeight);
+		if (xTiles > 1 && xTiles % 2 == 1)
+		{
+			xTiles--;
+		}
+		if (yTiles > 1 && yTiles % 2 == 1)
+		{
+			yTiles--;
+		}
+
+		tileWidth = (xSize + xTiles - 1) / xTiles;
+		tileHeight = (ySize + yTiles - 1) / yTiles;
+	}
+
+	// The last cell has no cell after it to read, unless it wraps around to the first
+	int xLast = (settings.tileable == 1) ? xSize : xSize - 1;
+	int yLast = (settings.tileable == 1) ? ySize : ySize - 1;
+
+	int tileCount = xTiles * yTiles;
+
+	// Splits the droplets into rounds, so every part of the map is eroded a bit at a time rather than tile by tile
+	int rounds = 8;
+	int dropletsPerTile = (settings.droplets + tileCount * rounds - 1) / (tileCount * rounds);
+
+	for (int round = 0; round < rounds; round++)
+	{
+		for (int pass = 0; pass < 4; pass++)
+		{
+			// The tiles in this pass
+			std::vector<int> tiles;
+			for (int ty = pass / 2; ty < yTiles; ty += 2)
+			{
+				for (int tx = pass % 2; tx < xTiles; tx += 2)
+				{
+					tiles.push_back(ty * xTiles + tx);
+				}
+			}
+
+			ParallelFor(tiles.size(), [&](int i)
+			{
+				int tile = tiles[i];
+				int xStart = (tile % xTiles) * tileWidth;
+				int yStart = (tile / xTiles) * tileHeight;
+				int xEnd = xStart + tileWidth;
+				int yEnd = yStart + tileHeight;
+				if (xEnd > xLast)
+				{
+					xEnd = xLast;
+				}
+				if (yEnd > yLast)
+				{
+					yEnd = yLast;
+				}
+				if (xEnd <= xStart || yEnd <= yStart)
+				{
+					return;
+				}
+
+				// Each tile has its own generator, seeded from the round and tile, so the droplets are the same every run
+				std::seed_seq seq = { settings.seed, (unsigned int)round, (unsigned int)tile };
+				std::mt19937 gen(seq);
+				std::uniform_real_distribution<float> xDistribution((float)xStart, (float)xEnd);
+				std::uniform_real_distribution<float> yDistribution((float)yStart, (float)yEnd);
+
+				for (int d = 0; d < dropletsPerTile; d++)
+				{
+					float x = xDistribution(gen);
+					float y = yDistribution(gen);
+
+					// Rounding can put the droplet on xLast, past the cells it can start from
+					if (x >= xLast || y >= yLast)
+					{
+						continue;
+					}
+
+					RunDroplet(map, xSize, ySize, x, y, settings, brush);
+				}
+			});
+		}
+	}
+}
+
+// How much material moves into a cell with height h from a neighbour with height n, negative if it moves out
+static inline float Exchange(float h, float n, float talus, float rate)
+{
+	return rate * (fmaxf(0.0f, n - h - talus) - fmaxf(0.0f, h - n - talus));
+}
+
+// Exchange for four cells at once
+static inline __m128 Exchange4(__m128 h, __m128 n, __m128 talus, __m128 rate)
+{
+	__m128 zero = _mm_setzero_ps();
+	__m128 in = _mm_max_ps(zero, _mm_sub_ps(_mm_sub_ps(n, h), talus));
+	__m128 out = _mm_max_ps(zero, _mm_sub_ps(_mm_sub_ps(h, n), talus));
+
+	return _mm_mul_ps(rate, _mm_sub_ps(in, out));
+}
+
+// Works out the next height of a single cell in a row, cells past the edge of the map count as the same height as the edge
+// When tiling, the cell past the edge is the one at the other end of the row
+static inline float ThermalCell(const float* up, const float* row, const float* down, int x, int xSize, int tileable, float talus, float rate)
+{
+	float h = row[x];
+	float left = (x > 0) ? row[x - 1] : (tileable == 1 ? row[xSize - 1] : h);
+	float right = (x < xSize - 1) ? row[x + 1] : (tileable == 1 ? row[0] : h);
+
+	return h + Exchange(h, left, talus, rate) + Exchange(h, right, talus, rate) + Exchange(h, up[x], talus, rate) + Exchange(h, down[x], talus, rate);
+}
+
+// Works out one row of the next iteration, four cells at a time
+static void ThermalRow(const float* up, const float* row, const float* down, float* out, int xSize, int tileable, float talus, float rate)
+{
+	// The first cell is missing its left neighbour, so it's done on its own
+	out[0] = ThermalCell(up, row, down, 0, xSize, tileable, talus, rate);
+
+	__m128 talus4 = _mm_set1_ps(talus);
+	__m128 rate4 = _mm_set1_ps(rate);
+
+	int x = 1;
+	for (; x + 4 <= xSize - 1; x += 4)
+	{
+		__m128 h = _mm_loadu_ps(row + x);
+
+		__m128 change = Exchange4(h, _mm_loadu_ps(row + x - 1), talus4, rate4);
+		change = _mm_add_ps(change, Exchange4(h, _mm_loadu_ps(row + x + 1), talus4, rate4));
+		change = _mm_add_ps(change, Exchange4(h, _mm_loadu_ps(up + x), talus4, rate4));
+		change = _mm_add_ps(change, Exchange4(h, _mm_loadu_ps(down + x), talus4, rate4));
+
+		_mm_storeu_ps(out + x, _mm_add_ps(h, change));
+	}
+
+	// The cells left over that don't fill four, and the last cell
+	for (; x < xSize; x++)
+	{
+		out[x] = ThermalCell(up, row, down, x, xSize, tileable, talus, rate);
+	}
+}
+
+void ThermalErosion(float** map, int xSize, int ySize, const ThermalSettings& settings)
+{
+	// Reads from one grid and writes to the other, then swaps, so every cell sees the last iteration's heights
+	std::vector<float> front((size_t)xSize * ySize);
+	std::vector<float> back((size_t)xSize * ySize);
+
+	for (int y = 0; y < ySize; y++)
+	{
+		memcpy(&front[(size_t)y * xSize], map[y], xSize * sizeof(float));
+	}
+
+	float* src = front.data();
+	float* dst = back.data();
+
+	// Each thread takes bands of rows
+	int bandSize = 32;
+	int bands = (ySize + bandSize - 1) / bandSize;
+
+	for (int i = 0; i < settings.iterations; i++)
+	{
+		ParallelFor(bands, [&](int band)
+		{
+			int yEnd = (band + 1) * bandSize;
+			if (yEnd > ySize)
+			{
+				yEnd = ySize;
+			}
+
+			for (int y = band * bandSize; y < yEnd; y++)
+			{
+				// When tiling, the row above the first is the last and the row below the last is the first
+				const float* row = src + (size_t)y * xSize;
+				const float* up = (y > 0) ? row - xSize : (settings.tileable == 1 ? src + (size_t)(ySize - 1) * xSize : row);
+				const float* down = (y < ySize - 1) ? row + xSize : (settings.tileable == 1 ? src : row);
+
+				ThermalRow(up, row, down, dst + (size_t)y * xSize, xSize, settings.tileable, settings.talus, settings.rate);
+			}
+		});
+
+		float* temp = src;
+		src = dst;
+		dst = temp;
+	}
+
+	for (int y = 0; y < ySize; y++)
+	{
+		memcpy(map[y], src + (size_t)y * xSize, xSize * sizeof(float));
+	}
+}
@@ -0,0 +1,55 @@
+/*
+	Erosion passes run over the height map after redistribution and the island pass
+*/
+
+#ifndef _EROSION_H_
+#define _EROSION_H_
+
+// Settings for HydraulicErosion, the defaults suit a height map scaled between 0 and 1
+struct ErosionSettings
+{
+	int droplets = 200000;
+	unsigned int seed = 0;
+
+	// How many steps a droplet lives for, and the radius it erodes over
+	int maxLifetime = 30;
+	int radius = 3;
+
+	float inertia = 0.05f;
+	float capacity = 4.0f;
+	float minSlope = 0.01f;
+	float erodeSpeed = 0.3f;
+	float depositSpeed = 0.3f;
+	float evaporateSpeed = 0.01f;
+	float gravity = 4.0f;
+	float startWater = 1.0f;
+	float startSpeed = 1.0f;
+
+	// 1 if the map tiles, droplets and the brush wrap around the edges instead of stopping at them
+	int tileable = 0;
+};
+
+// Simulates rain droplets running down map, each one eroding and depositing sediment as it goes
+// The droplets are run in parallel, the result only depends on settings.seed and not on the number of threads
+void HydraulicErosion(float** map, int xSize, int ySize, const ErosionSettings& settings);
+
+// Settings for ThermalErosion, the defaults suit a height map scaled between 0 and 1
+struct ThermalSettings
+{
+	int iterations = 100;
+
+	// The biggest height difference between neighbouring cells before material starts to slide
+	float talus = 0.006f;
+
+	// How much of the difference above the talus slides each iteration, more than 0.25 is unstable
+	float rate = 0.2f;
+
+	// 1 if the map tiles, cells on each edge then slide into the cells on the opposite edge
+	int tileable = 0;
+};
+
+// Slides material from steep cells to their lower neighbours, smoothing cliffs down towards the talus slope
+// The total height of the map is kept the same
+void ThermalErosion(float** map, int xSize, int ySize, const ThermalSettings& settings);
+
+#endif
@@ -0,0 +1,162 @@
+/*
+	Load generator for the generation server (see Server.h), built as its own program
+
+	Usage: LoadClient [port] [clients] [requests per client] [size] [distinct seeds]
+	Each client sends its requests one after another, all clients at once. The seeds cycle through
+	distinct seeds, so fewer distinct seeds means more requests the server can batch together.
+	Prints the latency each client saw, then the server's own metrics.
+*/
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#pragma comment (lib,"Ws2_32.lib")
+
+// Sends a GET for path to the server, and reads the whole reply into reply
+// Returns false if the server couldn't be reached
+bool Get(unsigned short port, const std::string& path, std::string& reply)
+{
+	SOCKET connection = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (connection == INVALID_SOCKET)
+	{
+		return false;
+	}
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+
+	if (connect(connection, (sockaddr*)&address, sizeof(address)) != 0)
+	{
+		closesocket(connection);
+		return false;
+	}
+
+	std::string request = "GET " + path + " HTTP/1.0\r\n\r\n";
+	if (send(connection, request.data(), (int)request.size(), 0) != (int)request.size())
+	{
+		closesocket(connection);
+		return false;
+	}
+
+	// The server closes the connection after the reply
+	reply.clear();
+	char buffer[65536];
+	int received = 0;
+	while ((received = recv(connection, buffer, sizeof(buffer), 0)) > 0)
+	{
+		reply.append(buffer, received);
+	}
+
+	closesocket(connection);
+	return true;
+}
+
+// Returns true if reply is a 200 with as many bytes as its Content-Length says
+bool ValidReply(const std::string& reply)
+{
+	size_t headerEnd = reply.find("\r\n\r\n");
+	size_t lengthStart = reply.find("Content-Length: ");
+	if (reply.compare(0, 12, "HTTP/1.0 200") != 0 || headerEnd == std::string::npos || lengthStart == std::string::npos)
+	{
+		return false;
+	}
+
+	size_t length = strtoull(reply.c_str() + lengthStart + 16, NULL, 10);
+	return reply.size() - (headerEnd + 4) == length;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned short port = argc > 1 ? (unsigned short)atoi(argv[1]) : 8037;
+	int clients = argc > 2 ? atoi(argv[2]) : 8;
+	int requests = argc > 3 ? atoi(argv[3]) : 50;
+	int size = argc > 4 ? atoi(argv[4]) : 128;
+	int seeds = argc > 5 ? atoi(argv[5]) : 4;
+
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		std::cout << "Couldn't start winsock" << std::endl;
+		return 1;
+	}
+
+	std::mutex resultsMutex;
+	std::vector<float> latencies;
+	int failures = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (int client = 0; client < clients; client++)
+	{
+		threads.push_back(std::thread([&, client]
+		{
+			std::string reply;
+
+			for (int i = 0; i < requests; i++)
+			{
+				char path[128];
+				sprintf_s(path, sizeof(path), "/generate?size=%d&seed=%d", size, (client * requests + i) % std::max(seeds, 1));
+
+				auto requestStart = std::chrono::steady_clock::now();
+				bool valid = Get(port, path, reply) && ValidReply(reply);
+				std::chrono::duration<float, std::milli> latency = std::chrono::steady_clock::now() - requestStart;
+
+				std::lock_guard<std::mutex> lock(resultsMutex);
+				if (valid)
+				{
+					latencies.push_back(latency.count());
+				}
+				else
+				{
+					failures++;
+				}
+			}
+		}));
+	}
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	std::chrono::duration<float> total = std::chrono::steady_clock::now() - start;
+
+	std::cout << latencies.size() << " requests, " << failures << " failed, in " << total.count() << "s" << std::endl;
+	if (!latencies.empty())
+	{
+		std::sort(latencies.begin(), latencies.end());
+
+		std::cout << latencies.size() / total.count() << " requests per second" << std::endl;
+		std::cout << "Client p50: " << latencies[(latencies.size() - 1) / 2] << "ms" << std::endl;
+		std::cout << "Client p99: " << latencies[(latencies.size() - 1) * 99 / 100] << "ms" << std::endl;
+		std::cout << "Client max: " << latencies.back() << "ms" << std::endl;
+	}
+
+	// The server's view, which doesn't include connecting
+	std::string metrics;
+	if (Get(port, "/metrics", metrics))
+	{
+		size_t body = metrics.find("\r\n\r\n");
+		if (body != std::string::npos)
+		{
+			std::cout << std::endl << "Server metrics:" << std::endl << metrics.substr(body + 4);
+		}
+	}
+
+	WSACleanup();
+	return failures == 0 ? 0 : 1;
+}
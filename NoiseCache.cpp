@@ -0,0 +1,224 @@
+#include "NoiseCache.h"
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+// The folder the cache files are kept in
+static const char* cacheFolder = "noiseCache";
+
+// Written at the start of every cache file, so a file can be checked against the key that loaded it
+// Padded to 64 bytes so the grids after it stay aligned
+struct NoiseCacheHeader
+{
+	char magic[4];
+	int version;
+	NoiseCacheKey key;
+	char padding[64 - 8 - sizeof(NoiseCacheKey)];
+};
+
+static const int cacheVersion = 1;
+
+// Gets the file name for key, from an FNV-1a hash of its bytes
+static std::string CachePath(const NoiseCacheKey& key)
+{
+	const unsigned char* bytes = (const unsigned char*)&key;
+	unsigned long long hash = 14695981039346656037ull;
+
+	for (int i = 0; i < sizeof(NoiseCacheKey); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	char name[64];
+	sprintf_s(name, "%s\\%016llx.noise", cacheFolder, hash);
+
+	return name;
+}
+
+// Makes the row pointers for a size by size grid stored at data
+// The offsets are worked out in size_t, as size * size overflows an int on big maps
+static float** MapRows(float* data, int size)
+{
+	float** grid = new float*[size];
+	for (int i = 0; i < size; i++)
+	{
+		grid[i] = data + (size_t)i * size;
+	}
+
+	return grid;
+}
+
+bool LoadCachedNoise(const NoiseCacheKey& key, MappedGrid& mapped)
+{
+	std::string path = CachePath(key);
+
+	// Write attributes is needed to mark the file as recently used
+	mapped.file = CreateFileA(path.c_str(), GENERIC_READ | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (mapped.file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	unsigned long long gridBytes = (unsigned long long)key.size * key.size * sizeof(float);
+
+	// Checks the file is the right size before mapping it
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(mapped.file, &fileSize) || (unsigned long long)fileSize.QuadPart != sizeof(NoiseCacheHeader) + gridBytes * 2)
+	{
+		ReleaseMappedGrid(mapped);
+		return false;
+	}
+
+	mapped.mapping = CreateFileMappingA(mapped.file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapped.mapping == NULL)
+	{
+		ReleaseMappedGrid(mapped);
+		return false;
+	}
+
+	mapped.view = MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0);
+	if (mapped.view == NULL)
+	{
+		ReleaseMappedGrid(mapped);
+		return false;
+	}
+
+	// Makes sure the file was made from the same key, and not just one with the same hash
+	const NoiseCacheHeader* header = (const NoiseCacheHeader*)mapped.view;
+	if (memcmp(header->magic, "PNCF", 4) != 0 || header->version != cacheVersion || memcmp(&header->key, &key, sizeof(NoiseCacheKey)) != 0)
+	{
+		ReleaseMappedGrid(mapped);
+		return false;
+	}
+
+	float* data = (float*)((char*)mapped.view + sizeof(NoiseCacheHeader));
+	mapped.grid = MapRows(data, key.size);
+	mapped.gridSimple = MapRows(data + (size_t)key.size * key.size, key.size);
+
+	// Marks the file as recently used, so it is evicted last
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	SetFileTime(mapped.file, NULL, NULL, &now);
+
+	return true;
+}
+
+void SaveCachedNoise(const NoiseCacheKey& key, float** grid, float** gridSimple)
+{
+	CreateDirectoryA(cacheFolder, NULL);
+
+	// Writes to a temporary file first, so a half written file is never loaded
+	std::string path = CachePath(key);
+	std::string tempPath = path + ".tmp";
+
+	HANDLE file = CreateFileA(tempPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	NoiseCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "PNCF", 4);
+	header.version = cacheVersion;
+	header.key = key;
+
+	DWORD written = 0;
+	DWORD rowBytes = key.size * sizeof(float);
+	bool ok = WriteFile(file, &header, sizeof(header), &written, NULL) != 0;
+
+	// Writes row by row, the grids may not be stored in one block
+	for (int i = 0; i < key.size && ok; i++)
+	{
+		ok = WriteFile(file, grid[i], rowBytes, &written, NULL) != 0 && written == rowBytes;
+	}
+	for (int i = 0; i < key.size && ok; i++)
+	{
+		ok = WriteFile(file, gridSimple[i], rowBytes, &written, NULL) != 0 && written == rowBytes;
+	}
+
+	CloseHandle(file);
+
+	if (!ok || !MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(tempPath.c_str());
+	}
+}
+
+void ReleaseMappedGrid(MappedGrid& mapped)
+{
+	delete[] mapped.grid;
+	delete[] mapped.gridSimple;
+	mapped.grid = nullptr;
+	mapped.gridSimple = nullptr;
+
+	if (mapped.view != NULL)
+	{
+		UnmapViewOfFile(mapped.view);
+		mapped.view = NULL;
+	}
+	if (mapped.mapping != NULL)
+	{
+		CloseHandle(mapped.mapping);
+		mapped.mapping = NULL;
+	}
+	if (mapped.file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mapped.file);
+		mapped.file = INVALID_HANDLE_VALUE;
+	}
+}
+
+// A file in the cache folder, used to sort by last use
+struct CacheFile
+{
+	std::string path;
+	unsigned long long bytes;
+	unsigned long long lastUsed;
+};
+
+void EvictCachedNoise(unsigned long long maxBytes)
+{
+	std::vector<CacheFile> files;
+	unsigned long long totalBytes = 0;
+
+	// Finds every cache file and how big it is
+	WIN32_FIND_DATAA findData;
+	std::string search = std::string(cacheFolder) + "\\*.noise";
+	HANDLE find = FindFirstFileA(search.c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	do
+	{
+		CacheFile cacheFile;
+		cacheFile.path = std::string(cacheFolder) + "\\" + findData.cFileName;
+		cacheFile.bytes = ((unsigned long long)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+		cacheFile.lastUsed = ((unsigned long long)findData.ftLastWriteTime.dwHighDateTime << 32) | findData.ftLastWriteTime.dwLowDateTime;
+
+		totalBytes += cacheFile.bytes;
+		files.push_back(cacheFile);
+	} while (FindNextFileA(find, &findData));
+
+	FindClose(find);
+
+	// Oldest first
+	std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b)
+	{
+		return a.lastUsed < b.lastUsed;
+	});
+
+	// Files that are still mapped can't be deleted, so they are skipped
+	for (int i = 0; i < files.size() && totalBytes > maxBytes; i++)
+	{
+		if (DeleteFileA(files[i].path.c_str()))
+		{
+			totalBytes -= files[i].bytes;
+		}
+	}
+}
@@ -0,0 +1,57 @@
+/*
+	On-disk cache of the raw FBM grids made by GeneratePerlinMap
+
+	Each grid is saved to its own file in the noiseCache folder, named after the hash of the
+	parameters that made it. A later run with the same parameters maps the file straight into
+	memory instead of regenerating the noise. The folder is kept under a size limit by deleting
+	the least recently used files.
+*/
+
+#ifndef _NOISECACHE_H_
+#define _NOISECACHE_H_
+
+#include <Windows.h>
+
+// Everything that changes the raw FBM grids
+// All the members are 4 bytes, so the struct has no padding and can be hashed and compared as bytes
+struct NoiseCacheKey
+{
+	unsigned int seed = 0;
+	float xSeed = 0.0f;
+	float ySeed = 0.0f;
+	float amplitude = 0.0f;
+	float frequency = 0.0f;
+	float persistance = 0.0f;
+	float lacunarity = 0.0f;
+	int octaves = 0;
+	int ridged = 0;
+	float tileSize = 0.0f;
+	float warp = 0.0f;
+	int size = 0;
+};
+
+// A pair of raw FBM grids mapped from a cache file
+// grid and gridSimple point straight into the mapped file, which is read only
+struct MappedGrid
+{
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+	void* view = NULL;
+
+	float** grid = nullptr;
+	float** gridSimple = nullptr;
+};
+
+// Maps the grids saved for key, returns false if they aren't in the cache
+bool LoadCachedNoise(const NoiseCacheKey& key, MappedGrid& mapped);
+
+// Saves grid and gridSimple, each key.size by key.size, to the cache
+void SaveCachedNoise(const NoiseCacheKey& key, float** grid, float** gridSimple);
+
+// Unmaps grids made by LoadCachedNoise
+void ReleaseMappedGrid(MappedGrid& mapped);
+
+// Deletes the least recently used cache files until the cache is no bigger than maxBytes
+void EvictCachedNoise(unsigned long long maxBytes);
+
+#endif
@@ -0,0 +1,188 @@
+/*
+	Helper for spreading a loop over every core
+*/
+
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <exception>
+
+// Threads that stay running for the whole process and work on every ParallelFor
+// They're shared, so generators running side by side split the cores between them instead of each
+// starting a thread per core, and a loop doesn't pay for starting and joining threads each time
+class ThreadPool
+{
+public:
+	static ThreadPool& Shared()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+
+	// Calls func(i) for every i from 0 to count - 1 on the pool's threads and the calling thread
+	// The calling thread works on its own loop until every i is handed out, so a loop always finishes even when
+	// the pool is busy with other loops, or it's called from inside another loop
+	// If func throws, the first exception is thrown again here once the rest of the loop is done
+	void For(int count, const std::function<void(int)>& func)
+	{
+		std::shared_ptr<Loop> loop = std::make_shared<Loop>(count, func);
+
+		if (!threads.empty())
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			loops.push_back(loop);
+			wake.notify_all();
+		}
+
+		Work(*loop);
+
+		// Every i has been handed out, wait for the pool's threads to finish theirs
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto i = loops.begin(); i != loops.end(); i++)
+			{
+				if (*i == loop)
+				{
+					loops.erase(i);
+					break;
+				}
+			}
+		}
+		{
+			std::unique_lock<std::mutex> lock(loop->mutex);
+			loop->done.wait(lock, [&] { return loop->finished == count; });
+		}
+
+		if (loop->error)
+		{
+			std::rethrow_exception(loop->error);
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			wake.notify_all();
+		}
+
+		for (int i = 0; i < threads.size(); i++)
+		{
+			threads[i].join();
+		}
+	}
+
+private:
+	struct Loop
+	{
+		Loop(int loopCount, const std::function<void(int)>& loopFunc) : count(loopCount), func(loopFunc), next(0), finished(0)
+		{
+		}
+
+		int count;
+		const std::function<void(int)>& func;
+
+		std::atomic<int> next;
+		std::atomic<int> finished;
+		std::exception_ptr error;
+
+		std::mutex mutex;
+		std::condition_variable done;
+	};
+
+	// The calling thread makes up the last core
+	ThreadPool() : stopping(false)
+	{
+		int threadCount = std::thread::hardware_concurrency();
+		for (int i = 1; i < threadCount; i++)
+		{
+			threads.push_back(std::thread(&ThreadPool::ThreadLoop, this));
+		}
+	}
+
+	// Each thread takes the next i as soon as it finishes one, so uneven work is balanced out
+	static void Work(Loop& loop)
+	{
+		for (int i = loop.next++; i < loop.count; i = loop.next++)
+		{
+			try
+			{
+				loop.func(i);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(loop.mutex);
+				if (!loop.error)
+				{
+					loop.error = std::current_exception();
+				}
+			}
+
+			if (++loop.finished == loop.count)
+			{
+				std::lock_guard<std::mutex> lock(loop.mutex);
+				loop.done.notify_all();
+			}
+		}
+	}
+
+	void ThreadLoop()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			wake.wait(lock, [this] { return stopping || !loops.empty(); });
+			if (stopping)
+			{
+				return;
+			}
+
+			// Loops with nothing left to hand out come off the queue, their calling thread waits for the rest
+			std::shared_ptr<Loop> loop = loops.front();
+			if (loop->next >= loop->count)
+			{
+				loops.pop_front();
+				continue;
+			}
+
+			lock.unlock();
+			Work(*loop);
+			lock.lock();
+		}
+	}
+
+	std::vector<std::thread> threads;
+	std::deque<std::shared_ptr<Loop>> loops;
+	bool stopping;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+};
+
+// Calls func(i) for every i from 0 to count - 1, spread over all the cores
+template <typename Func>
+void ParallelFor(int count, Func func)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	if (count == 1)
+	{
+		func(0);
+		return;
+	}
+
+	ThreadPool::Shared().For(count, [&func](int i) { func(i); });
+}
+
+#endif
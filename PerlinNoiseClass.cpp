@@ -1,5 +1,22 @@
 #include "PerlinNoiseClass.h"
 
+// init makes the tables from this rather than rand, so it doesn't disturb the rand of the program using it
+// It's the same sequence as the Microsoft CRT's rand, so a seed still makes the map it always has, and each thread has
+// its own, so generators on different threads can make their tables at once
+static thread_local unsigned int tableSeed = 1;
+
+// Seeds the tables made by the next init on this thread
+void SeedPerlinTables(unsigned int seed)
+{
+	tableSeed = seed;
+}
+
+static int TableRand()
+{
+	tableSeed = tableSeed * 214013u + 2531011u;
+	return (tableSeed >> 16) & 0x7fff;
+}
+
 PerlinNoiseClass::PerlinNoiseClass()
 {
 }
@@ -33,7 +50,7 @@ float PerlinNoiseClass::noise2(float vec[2])
 {
 	int bx0, bx1, by0, by1, b00, b10, b01, b11;
 	float rx0, rx1, ry0, ry1, *q, sx, sy, a, b, t, u, v;
-	register int i, j;
+	int i, j;
 
 	if (start)
 	{
@@ -68,11 +85,68 @@ float PerlinNoiseClass::noise2(float vec[2])
 	return lerp(sy, a, b);
 }
 
+// Periodic version of noise2, the lattice wraps every px cells in x and py cells in y so the noise tiles
+float PerlinNoiseClass::pnoise2(float vec[2], int px, int py)
+{
+	int bx0, bx1, by0, by1, b00, b10, b01, b11;
+	float rx0, rx1, ry0, ry1, *q, sx, sy, a, b, t, u, v;
+	int i, j;
+
+	if (start)
+	{
+		start = 0;
+		init();
+	}
+
+	// Like setup, but with floor, as casting rounds towards 0 and would put points left of or above -N in the wrong cell
+	t = vec[0] + N;
+	u = floorf(t);
+	rx0 = t - u;
+	rx1 = rx0 - 1.0f;
+	i = (int)u;
+
+	t = vec[1] + N;
+	v = floorf(t);
+	ry0 = t - v;
+	ry1 = ry0 - 1.0f;
+	j = (int)v;
+
+	// Wraps the lattice cells around the period before looking them up, % keeps the sign so negative cells are moved up
+	i = (i % px + px) % px;
+	j = (j % py + py) % py;
+
+	bx0 = i & BM;
+	bx1 = ((i + 1) % px) & BM;
+	by0 = j & BM;
+	by1 = ((j + 1) % py) & BM;
+
+	i = p[bx0];
+	j = p[bx1];
+
+	b00 = p[i + by0];
+	b10 = p[j + by0];
+	b01 = p[i + by1];
+	b11 = p[j + by1];
+
+	sx = s_curve(rx0);
+	sy = s_curve(ry0);
+
+	q = g2[b00]; u = at2(rx0, ry0);
+	q = g2[b10]; v = at2(rx1, ry0);
+	a = lerp(sx, u, v);
+
+	q = g2[b01]; u = at2(rx0, ry1);
+	q = g2[b11]; v = at2(rx1, ry1);
+	b = lerp(sx, u, v);
+
+	return lerp(sy, a, b);
+}
+
 float PerlinNoiseClass::noise3(float vec[3])
 {
 	int bx0, bx1, by0, by1, bz0, bz1, b00, b10, b01, b11;
 	float rx0, rx1, ry0, ry1, rz0, rz1, *q, sy, sz, a, b, c, d, t, u, v;
-	register int i, j;
+	int i, j;
 
 	if (start) {
 		start = 0;
@@ -146,20 +220,20 @@ void PerlinNoiseClass::init(void)
 	for (i = 0; i < B; i++) {
 		p[i] = i;
 
-		g1[i] = (float)((rand() % (B + B)) - B) / B;
+		g1[i] = (float)((TableRand() % (B + B)) - B) / B;
 
 		for (j = 0; j < 2; j++)
-			g2[i][j] = (float)((rand() % (B + B)) - B) / B;
+			g2[i][j] = (float)((TableRand() % (B + B)) - B) / B;
 		normalize2(g2[i]);
 
 		for (j = 0; j < 3; j++)
-			g3[i][j] = (float)((rand() % (B + B)) - B) / B;
+			g3[i][j] = (float)((TableRand() % (B + B)) - B) / B;
 		normalize3(g3[i]);
 	}
 
 	while (--i) {
 		k = p[i];
-		p[i] = p[j = rand() % B];
+		p[i] = p[j = TableRand() % B];
 		p[j] = k;
 	}
 
@@ -0,0 +1,62 @@
+/*
+	Ken Perlin's original gradient noise, in 1, 2 and 3 dimensions
+
+	The gradient and permutation tables are made from a seed by init, the first noise call makes
+	them if init hasn't been called. pnoise2 is noise2 with the lattice wrapped, so it tiles.
+*/
+
+#ifndef _PERLINNOISECLASS_H_
+#define _PERLINNOISECLASS_H_
+
+#include <math.h>
+#include <stdlib.h>
+
+// Table size, and the offset added to coordinates so they're positive before being cut to lattice cells
+#define B 0x100
+#define BM 0xff
+#define N 0x1000
+#define NP 12
+#define NM 0xfff
+
+#define s_curve(t) ( t * t * (3. - 2. * t) )
+#define lerp(t, a, b) ( a + t * (b - a) )
+
+// Finds the lattice cells either side of vec[i], b0 and b1, and how far past each of them vec[i] is, r0 and r1
+#define setup(i, b0, b1, r0, r1)\
+	t = vec[i] + N;\
+	b0 = ((int)t) & BM;\
+	b1 = (b0 + 1) & BM;\
+	r0 = t - (int)t;\
+	r1 = r0 - 1.;
+
+// Seeds the tables made by the next init on this thread
+void SeedPerlinTables(unsigned int seed);
+
+class PerlinNoiseClass
+{
+public:
+	PerlinNoiseClass();
+	~PerlinNoiseClass();
+
+	double noise1(double arg);
+	float noise2(float vec[2]);
+	float noise3(float vec[3]);
+
+	// noise2 with the lattice wrapping every px cells in x and py cells in y, so the noise tiles
+	float pnoise2(float vec[2], int px, int py);
+
+	void normalize2(float v[2]);
+	void normalize3(float v[3]);
+
+	// Makes the tables from the seed given to SeedPerlinTables
+	void init(void);
+
+private:
+	int p[B + B + 2];
+	float g3[B + B + 2][3];
+	float g2[B + B + 2][2];
+	float g1[B + B + 2];
+	int start = 1;
+};
+
+#endif
@@ -0,0 +1,59 @@
+/*
+	Helpers for passing row bands of a map through several stages at once
+*/
+
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include "Parallel.h"
+#include <mutex>
+#include <vector>
+#include <functional>
+
+// Passes every band from 0 to bands - 1 through each stage in order, stages[s](band)
+// The first stage is spread over every core. Every stage after it is given the bands in order, one band at a time,
+// by whichever thread finished the next band, so while that thread works on the later stages the others carry on
+// with the first stage of the bands after it
+inline void RunBandPipeline(int bands, const std::vector<std::function<void(int)>>& stages)
+{
+	if (stages.empty())
+	{
+		return;
+	}
+
+	// The first stage can finish bands out of order, they are passed on once every band before them is done
+	std::mutex orderMutex;
+	std::vector<bool> finished(bands, false);
+	int nextBand = 0;
+	bool passing = false;
+
+	ParallelFor(bands, [&](int band)
+	{
+		stages[0](band);
+
+		std::unique_lock<std::mutex> lock(orderMutex);
+		finished[band] = true;
+
+		// Another thread is already passing bands on, it will pick this one up when it gets to it
+		if (passing)
+		{
+			return;
+		}
+
+		passing = true;
+		while (nextBand < bands && finished[nextBand])
+		{
+			int next = nextBand++;
+
+			lock.unlock();
+			for (int s = 1; s < stages.size(); s++)
+			{
+				stages[s](next);
+			}
+			lock.lock();
+		}
+		passing = false;
+	});
+}
+
+#endif
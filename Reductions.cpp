@@ -0,0 +1,262 @@
+#include "Reductions.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+// Rows given to each thread at a time
+const int chunkRows = 16;
+
+// Bins used to narrow down a percentile before sorting what's left
+const int percentileBins = 4096;
+
+static int ChunkCount(int ySize)
+{
+	return (ySize + chunkRows - 1) / chunkRows;
+}
+
+// Min and max of one row
+static void RowRange(const float* row, int xSize, float& min, float& max)
+{
+	int x = 0;
+
+	if (xSize >= 4)
+	{
+		__m128 min4 = _mm_loadu_ps(row);
+		__m128 max4 = min4;
+
+		for (x = 4; x + 4 <= xSize; x += 4)
+		{
+			__m128 values = _mm_loadu_ps(row + x);
+			min4 = _mm_min_ps(min4, values);
+			max4 = _mm_max_ps(max4, values);
+		}
+
+		float mins[4];
+		float maxs[4];
+		_mm_storeu_ps(mins, min4);
+		_mm_storeu_ps(maxs, max4);
+
+		for (int i = 0; i < 4; i++)
+		{
+			min = std::min(min, mins[i]);
+			max = std::max(max, maxs[i]);
+		}
+	}
+
+	// The last few that don't fill 4
+	for (; x < xSize; x++)
+	{
+		min = std::min(min, row[x]);
+		max = std::max(max, row[x]);
+	}
+}
+
+// The lowest and highest values in the map
+HeightRange ReduceRange(const float* data, int stride, int xSize, int ySize)
+{
+	int chunks = ChunkCount(ySize);
+	std::vector<HeightRange> ranges(chunks);
+
+	ParallelFor(chunks, [&](int chunk)
+	{
+		float min = data[(size_t)chunk * chunkRows * stride];
+		float max = min;
+
+		for (int y = chunk * chunkRows; y < std::min((chunk + 1) * chunkRows, ySize); y++)
+		{
+			RowRange(data + (size_t)y * stride, xSize, min, max);
+		}
+
+		ranges[chunk].min = min;
+		ranges[chunk].max = max;
+	});
+
+	HeightRange range = ranges[0];
+	for (int chunk = 1; chunk < chunks; chunk++)
+	{
+		range.min = std::min(range.min, ranges[chunk].min);
+		range.max = std::max(range.max, ranges[chunk].max);
+	}
+
+	return range;
+}
+
+// All the values in the map added up
+double ReduceSum(const float* data, int stride, int xSize, int ySize)
+{
+	int chunks = ChunkCount(ySize);
+	std::vector<double> sums(chunks, 0.0);
+
+	ParallelFor(chunks, [&](int chunk)
+	{
+		double sum = 0.0;
+
+		for (int y = chunk * chunkRows; y < std::min((chunk + 1) * chunkRows, ySize); y++)
+		{
+			const float* row = data + (size_t)y * stride;
+
+			// Each row is added up in floats, and the rows in a double, so big maps don't lose precision
+			__m128 sum4 = _mm_setzero_ps();
+			int x = 0;
+			for (; x + 4 <= xSize; x += 4)
+			{
+				sum4 = _mm_add_ps(sum4, _mm_loadu_ps(row + x));
+			}
+
+			float sums4[4];
+			_mm_storeu_ps(sums4, sum4);
+
+			float rowSum = (sums4[0] + sums4[1]) + (sums4[2] + sums4[3]);
+			for (; x < xSize; x++)
+			{
+				rowSum += row[x];
+			}
+
+			sum += rowSum;
+		}
+
+		sums[chunk] = sum;
+	});
+
+	double total = 0.0;
+	for (int chunk = 0; chunk < chunks; chunk++)
+	{
+		total += sums[chunk];
+	}
+
+	return total;
+}
+
+// Works out the bin of 4 values at once, clamped to the histogram
+static inline __m128i Bins4(__m128 values, __m128 min4, __m128 range4, __m128 bins4, __m128i last4)
+{
+	__m128 position = _mm_mul_ps(_mm_div_ps(_mm_sub_ps(values, min4), range4), bins4);
+	__m128i bin = _mm_cvttps_epi32(position);
+
+	// SSE2 has no integer min and max, so they are done with compares
+	__m128i zero = _mm_setzero_si128();
+	bin = _mm_and_si128(bin, _mm_cmpgt_epi32(bin, zero));
+	__m128i over = _mm_cmpgt_epi32(bin, last4);
+
+	return _mm_or_si128(_mm_and_si128(over, last4), _mm_andnot_si128(over, bin));
+}
+
+// The bin of one value, matches Bins4
+static inline int Bin(float value, float min, float range, float bins, int last)
+{
+	int bin = (int)((value - min) / range * bins);
+
+	return std::max(0, std::min(bin, last));
+}
+
+// Counts the values into histogram.size() equal bins from min to max, values outside go in the end bins
+void ReduceHistogram(const float* data, int stride, int xSize, int ySize, float min, float max, std::vector<unsigned int>& histogram)
+{
+	int binCount = histogram.size();
+	int chunks = ChunkCount(ySize);
+	float range = max - min;
+
+	// Each chunk counts into its own histogram, which are added together at the end
+	std::vector<std::vector<unsigned int>> counts(chunks);
+
+	ParallelFor(chunks, [&](int chunk)
+	{
+		std::vector<unsigned int>& count = counts[chunk];
+		count.assign(binCount, 0);
+
+		__m128 min4 = _mm_set1_ps(min);
+		__m128 range4 = _mm_set1_ps(range);
+		__m128 bins4 = _mm_set1_ps((float)binCount);
+		__m128i last4 = _mm_set1_epi32(binCount - 1);
+
+		for (int y = chunk * chunkRows; y < std::min((chunk + 1) * chunkRows, ySize); y++)
+		{
+			const float* row = data + (size_t)y * stride;
+
+			int x = 0;
+			for (; x + 4 <= xSize; x += 4)
+			{
+				int bins[4];
+				_mm_storeu_si128((__m128i*)bins, Bins4(_mm_loadu_ps(row + x), min4, range4, bins4, last4));
+
+				count[bins[0]]++;
+				count[bins[1]]++;
+				count[bins[2]]++;
+				count[bins[3]]++;
+			}
+
+			for (; x < xSize; x++)
+			{
+				count[Bin(row[x], min, range, (float)binCount, binCount - 1)]++;
+			}
+		}
+	});
+
+	std::fill(histogram.begin(), histogram.end(), 0);
+	for (int chunk = 0; chunk < chunks; chunk++)
+	{
+		for (int bin = 0; bin < binCount; bin++)
+		{
+			histogram[bin] += counts[chunk][bin];
+		}
+	}
+}
+
+// The value that fraction of the map is at or below, from 0 (the lowest value) to 1 (the highest)
+float ReducePercentile(const float* data, int stride, int xSize, int ySize, float fraction)
+{
+	HeightRange range = ReduceRange(data, stride, xSize, ySize);
+	if (range.min == range.max)
+	{
+		return range.min;
+	}
+
+	fraction = std::max(0.0f, std::min(fraction, 1.0f));
+	size_t count = (size_t)xSize * ySize;
+	size_t k = (size_t)(fraction * (count - 1));
+
+	// Finds the bin the kth value is in
+	std::vector<unsigned int> histogram(percentileBins);
+	ReduceHistogram(data, stride, xSize, ySize, range.min, range.max, histogram);
+
+	int target = 0;
+	size_t below = 0;
+	while (below + histogram[target] <= k)
+	{
+		below += histogram[target];
+		target++;
+	}
+
+	// Only the values in that bin need sorting
+	int chunks = ChunkCount(ySize);
+	std::vector<std::vector<float>> inBin(chunks);
+	float valueRange = range.max - range.min;
+
+	ParallelFor(chunks, [&](int chunk)
+	{
+		for (int y = chunk * chunkRows; y < std::min((chunk + 1) * chunkRows, ySize); y++)
+		{
+			const float* row = data + (size_t)y * stride;
+
+			for (int x = 0; x < xSize; x++)
+			{
+				if (Bin(row[x], range.min, valueRange, (float)percentileBins, percentileBins - 1) == target)
+				{
+					inBin[chunk].push_back(row[x]);
+				}
+			}
+		}
+	});
+
+	std::vector<float> values;
+	values.reserve(histogram[target]);
+	for (int chunk = 0; chunk < chunks; chunk++)
+	{
+		values.insert(values.end(), inBin[chunk].begin(), inBin[chunk].end());
+	}
+
+	std::nth_element(values.begin(), values.begin() + (k - below), values.end());
+
+	return values[k - below];
+}
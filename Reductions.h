@@ -0,0 +1,34 @@
+/*
+	Reductions over height maps
+
+	Each works on a view of a map, ySize rows of xSize floats, with row y starting at data + y * stride
+	The rows are split between the cores, and each row is worked through 4 floats at a time with SSE
+*/
+
+#ifndef _REDUCTIONS_H_
+#define _REDUCTIONS_H_
+
+#include <vector>
+
+struct HeightRange
+{
+	float min = 0.0f;
+	float max = 0.0f;
+};
+
+// The lowest and highest values in the map
+HeightRange ReduceRange(const float* data, int stride, int xSize, int ySize);
+
+// All the values in the map added up
+double ReduceSum(const float* data, int stride, int xSize, int ySize);
+
+// Counts the values into histogram.size() equal bins from min to max, values outside go in the end bins
+// A value goes in bin (int)((value - min) / (max - min) * bins), the same sum Scale uses, so a histogram of a map
+// from its min to max matches a histogram of the scaled map from 0 to 1
+void ReduceHistogram(const float* data, int stride, int xSize, int ySize, float min, float max, std::vector<unsigned int>& histogram);
+
+// The value that fraction of the map is at or below, from 0 (the lowest value) to 1 (the highest)
+// Exact, it's the kth lowest value with k = fraction * (count - 1) rounded down
+float ReducePercentile(const float* data, int stride, int xSize, int ySize, float fraction);
+
+#endif
@@ -0,0 +1,224 @@
+#include "RtinMesh.h"
+#include "TerrainMesh.h"
+#include "Parallel.h"
+#include <math.h>
+#include <fstream>
+
+// The height error at (mx, my) if it were left out, and the line from (ax, ay) to (bx, by) was drawn instead
+static float MidpointError(const RtinTile& tile, int ax, int ay, int bx, int by, int mx, int my)
+{
+	int size = tile.gridSize;
+	float interpolated = (tile.heights[ay * size + ax] + tile.heights[by * size + bx]) / 2.0f;
+
+	return fabsf(interpolated - tile.heights[my * size + mx]);
+}
+
+// Raises error to the error at (x, y) if it's inside the grid
+static void MaxError(const RtinTile& tile, int x, int y, float& error)
+{
+	if (x >= 0 && y >= 0 && x < tile.gridSize && y < tile.gridSize)
+	{
+		error = fmaxf(error, tile.errors[y * tile.gridSize + x]);
+	}
+}
+
+RtinTile BuildRtinTile(float** map, int xSize, int ySize)
+{
+	RtinTile tile;
+
+	// The smallest 2^n + 1 grid that fits the whole map
+	int largest = (xSize > ySize) ? xSize : ySize;
+	int tileSize = 1;
+	while (tileSize + 1 < largest)
+	{
+		tileSize *= 2;
+	}
+
+	int size = tileSize + 1;
+	tile.gridSize = size;
+	tile.heights.resize(size * size);
+	tile.errors.assign(size * size, 0.0f);
+
+	ParallelFor(size, [&](int y)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			tile.heights[y * size + x] = SampleMap(map, xSize, ySize, (float)x / tileSize, (float)y / tileSize);
+		}
+	});
+
+	// Smallest triangles first, so each point's error can include the errors of the points inside its triangles
+	// At each level h, the points are the middles of the edges of 2h by 2h squares, then the middles of the squares
+	for (int h = 1; h < tileSize; h *= 2)
+	{
+		int step = h * 2;
+
+		// Edge middles, the triangles either side of the edge have the square middles at h / 2 inside them
+		auto edgeMiddle = [&](int x, int y, bool horizontal)
+		{
+			float error = horizontal ? MidpointError(tile, x - h, y, x + h, y, x, y) : MidpointError(tile, x, y - h, x, y + h, x, y);
+
+			if (h > 1)
+			{
+				int q = h / 2;
+				MaxError(tile, x - q, y - q, error);
+				MaxError(tile, x + q, y - q, error);
+				MaxError(tile, x - q, y + q, error);
+				MaxError(tile, x + q, y + q, error);
+			}
+
+			tile.errors[y * size + x] = error;
+		};
+
+		ParallelFor(size, [&](int y)
+		{
+			if (y % step == 0)
+			{
+				for (int x = h; x < size; x += step)
+				{
+					edgeMiddle(x, y, true);
+				}
+			}
+			else if (y % step == h)
+			{
+				for (int x = 0; x < size; x += step)
+				{
+					edgeMiddle(x, y, false);
+				}
+			}
+		});
+
+		// Square middles, the triangles either side of the diagonal have the square's edge middles inside them
+		ParallelFor(tileSize / step, [&](int row)
+		{
+			int y = row * step + h;
+
+			for (int x = h; x < size; x += step)
+			{
+				// The diagonal goes through the middle of the square twice the size, or corner to corner for the whole map
+				int ax = 0;
+				int ay = 0;
+				if (step < tileSize)
+				{
+					int parentX = (x - h) - (x - h) % (step * 2) + step;
+					int parentY = (y - h) - (y - h) % (step * 2) + step;
+					ax = parentX;
+					ay = parentY;
+				}
+				int bx = 2 * x - ax;
+				int by = 2 * y - ay;
+
+				float error = MidpointError(tile, ax, ay, bx, by, x, y);
+				MaxError(tile, x - h, y, error);
+				MaxError(tile, x + h, y, error);
+				MaxError(tile, x, y - h, error);
+				MaxError(tile, x, y + h, error);
+
+				tile.errors[y * size + x] = error;
+			}
+		});
+	}
+
+	return tile;
+}
+
+// Walks down the triangles, splitting any whose middle point has too much error
+class RtinBuilder
+{
+public:
+	RtinBuilder(const RtinTile& tile, float maxError, float cellSize, float heightScale, RtinMesh& mesh)
+		: tile(tile), maxError(maxError), cellSize(cellSize), heightScale(heightScale), mesh(mesh), vertexIndex(tile.gridSize * tile.gridSize, -1)
+	{
+	}
+
+	// The triangle (a, b, c) has its right angle at c, and its longest side from a to b
+	void AddTriangle(int ax, int ay, int bx, int by, int cx, int cy)
+	{
+		int mx = (ax + bx) / 2;
+		int my = (ay + by) / 2;
+
+		if (abs(ax - cx) + abs(ay - cy) > 1 && tile.errors[my * tile.gridSize + mx] * heightScale > maxError)
+		{
+			AddTriangle(cx, cy, ax, ay, mx, my);
+			AddTriangle(bx, by, cx, cy, mx, my);
+			return;
+		}
+
+		int a = Vertex(ax, ay);
+		int b = Vertex(bx, by);
+		int c = Vertex(cx, cy);
+
+		// Wound clockwise when looked at from above, to match the tessellated mesh
+		int area = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+
+		mesh.indices.push_back(a);
+		mesh.indices.push_back(area > 0 ? c : b);
+		mesh.indices.push_back(area > 0 ? b : c);
+	}
+
+private:
+	// Gets the index of the vertex at (x, y), adding it the first time it's used
+	int Vertex(int x, int y)
+	{
+		int& index = vertexIndex[y * tile.gridSize + x];
+
+		if (index == -1)
+		{
+			index = (int)mesh.vertices.size() / 3;
+
+			mesh.vertices.push_back(x * cellSize);
+			mesh.vertices.push_back(tile.heights[y * tile.gridSize + x] * heightScale);
+			mesh.vertices.push_back(y * cellSize);
+		}
+
+		return index;
+	}
+
+	const RtinTile& tile;
+	float maxError;
+	float cellSize;
+	float heightScale;
+	RtinMesh& mesh;
+	std::vector<int> vertexIndex;
+};
+
+RtinMesh ExtractRtinMesh(const RtinTile& tile, float maxError, float worldSize, float heightScale)
+{
+	RtinMesh mesh;
+	int last = tile.gridSize - 1;
+
+	RtinBuilder builder(tile, maxError, worldSize / last, heightScale, mesh);
+
+	// The two halves of the map, split corner to corner
+	builder.AddTriangle(0, 0, last, last, last, 0);
+	builder.AddTriangle(last, last, 0, 0, 0, last);
+
+	return mesh;
+}
+
+float GeometricError(float pixels, float distance, float fovY, int screenHeight)
+{
+	return pixels * (2.0f * distance * tanf(fovY / 2.0f)) / screenHeight;
+}
+
+bool SaveRtinMesh(const char* fileName, const RtinMesh& mesh)
+{
+	std::ofstream file(fileName, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	unsigned int version = 1;
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size() / 3;
+	unsigned int indexCount = (unsigned int)mesh.indices.size();
+
+	file.write("RTIN", 4);
+	file.write((const char*)&version, sizeof(version));
+	file.write((const char*)&vertexCount, sizeof(vertexCount));
+	file.write((const char*)&indexCount, sizeof(indexCount));
+	file.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+	file.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+
+	return file.good();
+}
@@ -0,0 +1,47 @@
+/*
+	Simplified terrain meshes, using a right-triangulated irregular network (RTIN)
+
+	The height map is resampled to a 2^n + 1 grid, which is split into right angled triangles by
+	repeatedly cutting each triangle in half across its longest side. BuildRtinTile works out, once,
+	the worst height error there would be at every point if the triangles around it weren't split.
+	ExtractRtinMesh can then make a mesh for any error without redoing that work, only splitting
+	triangles whose error is too big.
+*/
+
+#ifndef _RTINMESH_H_
+#define _RTINMESH_H_
+
+#include <vector>
+
+// The height map resampled to a 2^n + 1 grid, and the error at each point
+struct RtinTile
+{
+	int gridSize = 0;
+	std::vector<float> heights;
+	std::vector<float> errors;
+};
+
+// A simplified mesh, vertices holds x, y, z for each vertex
+struct RtinMesh
+{
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+};
+
+// Resamples map and works out the errors, in time proportional to the number of grid points
+RtinTile BuildRtinTile(float** map, int xSize, int ySize);
+
+// Makes a mesh where no point is further than maxError world units above or below the height map
+// The mesh is worldSize units across, and heights are scaled by heightScale
+RtinMesh ExtractRtinMesh(const RtinTile& tile, float maxError, float worldSize, float heightScale);
+
+// Converts an error in pixels on screen to an error in world units, for something distance away
+// from a camera with a vertical field of view of fovY radians, rendering screenHeight pixels high
+float GeometricError(float pixels, float distance, float fovY, int screenHeight);
+
+// Writes the mesh to fileName, returns false if the file couldn't be written
+// The file is "RTIN", a version number, the vertex count and the index count, then the vertices as 3 floats each
+// and the indices as 32 bit unsigned ints, all little endian
+bool SaveRtinMesh(const char* fileName, const RtinMesh& mesh);
+
+#endif
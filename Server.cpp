@@ -0,0 +1,667 @@
+/*
+	Local generation server, see Server.h
+*/
+
+// Has to be before Windows.h, which pulls in the old winsock
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include "Server.h"
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <map>
+#include <tuple>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <stdexcept>
+
+#pragma comment (lib,"Ws2_32.lib")
+
+// How many of the most recent latencies the percentiles are worked out from
+const size_t latencySamples = 10000;
+
+// A request waiting for its map, owned by the connection that read it
+struct TerrainServer::PendingRequest
+{
+	GenerateRequest request;
+	unsigned long long hash = 0;
+	bool rivers = false;
+
+	std::vector<float> heights;
+	std::vector<float> riverMap;
+	GenerateReport report;
+
+	std::promise<void> finished;
+};
+
+// A thread with its own generator, and the batches of identical requests it has been given
+struct TerrainServer::Worker
+{
+	TerrainGenerator generator;
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<std::vector<PendingRequest*>> jobs;
+	bool stop = false;
+
+	std::thread thread;
+};
+
+// The fields of request in the order the generator's stages use them, the seed first as it picks the worker
+// Sorting by it puts requests next to each other that share the most stages from the start
+auto StageOrder(const GenerateRequest& r) -> decltype(std::make_tuple(r.seed, r.size, r.xSeed, r.ySeed, r.amplitude, r.frequency, r.persistance, r.lacunarity,
+	r.octaves, r.ridged, r.tileable, r.warp, r.redis, r.equalise, r.islands, r.antiIsland, r.islandRange, r.droplets, r.thermalIterations,
+	r.numOfRivers, r.minRiverLength, r.heightFromTop, r.spawnFraction, r.betterGen))
+{
+	return std::make_tuple(r.seed, r.size, r.xSeed, r.ySeed, r.amplitude, r.frequency, r.persistance, r.lacunarity,
+		r.octaves, r.ridged, r.tileable, r.warp, r.redis, r.equalise, r.islands, r.antiIsland, r.islandRange, r.droplets, r.thermalIterations,
+		r.numOfRivers, r.minRiverLength, r.heightFromTop, r.spawnFraction, r.betterGen);
+}
+
+// Sends all of length bytes, returns false if the connection closed
+bool SendAll(SOCKET connection, const char* data, size_t length)
+{
+	while (length > 0)
+	{
+		int chunk = (int)std::min(length, (size_t)(1 << 20));
+		int sent = send(connection, data, chunk, 0);
+		if (sent <= 0)
+		{
+			return false;
+		}
+
+		data += sent;
+		length -= sent;
+	}
+
+	return true;
+}
+
+// Sends a text reply
+bool SendText(SOCKET connection, const char* status, const std::string& body)
+{
+	char header[256];
+	sprintf_s(header, sizeof(header), "HTTP/1.0 %s\r\nContent-Type: text/plain\r\nContent-Length: %d\r\n\r\n", status, (int)body.size());
+
+	return SendAll(connection, header, strlen(header)) && SendAll(connection, body.data(), body.size());
+}
+
+// Reads a whole number from value, returns false if it isn't one or is outside min to max
+bool ParseInt(const char* value, long long min, long long max, long long& number)
+{
+	char* end = NULL;
+	number = strtoll(value, &end, 10);
+
+	return end != value && *end == '\0' && number >= min && number <= max;
+}
+
+// Reads a number from value, returns false if it isn't one or is outside min to max
+bool ParseFloat(const char* value, float min, float max, float& number)
+{
+	char* end = NULL;
+	number = strtof(value, &end);
+
+	// NaN fails both comparisons
+	return end != value && *end == '\0' && number >= min && number <= max;
+}
+
+// Sets the GenerateRequest field called name to value
+// Returns false, with why in error, if there is no such field or the value is out of its range
+// The ranges keep a request from asking for more work or memory than a map can use, or values that make no map at all
+bool SetRequestField(GenerateRequest& request, bool& rivers, const std::string& name, const char* value, int maxSize, std::string& error)
+{
+	struct IntField { const char* name; int* field; int min; int max; };
+	struct FloatField { const char* name; float* field; float min; float max; };
+
+	int riversFlag = 0;
+
+	IntField intFields[] =
+	{
+		{ "size", &request.size, 2, maxSize }, { "octaves", &request.octaves, 1, 16 }, { "ridged", &request.ridged, 0, 2 },
+		{ "tileable", &request.tileable, 0, 1 }, { "islands", &request.islands, 0, 1 }, { "antiIsland", &request.antiIsland, 0, 1 },
+		{ "droplets", &request.droplets, 0, 10000000 }, { "thermalIterations", &request.thermalIterations, 0, 1000 },
+		{ "numOfRivers", &request.numOfRivers, 0, 500 }, { "minRiverLength", &request.minRiverLength, 0, 100000 }, { "betterGen", &request.betterGen, 0, 1 },
+		{ "equalise", &request.equalise, 0, 1 }, { "rivers", &riversFlag, 0, 1 },
+	};
+
+	FloatField floatFields[] =
+	{
+		{ "xSeed", &request.xSeed, -1000000.0f, 1000000.0f }, { "ySeed", &request.ySeed, -1000000.0f, 1000000.0f },
+		{ "amplitude", &request.amplitude, 0.001f, 10.0f }, { "frequency", &request.frequency, 0.001f, 10.0f },
+		{ "persistance", &request.persistance, 0.0f, 10.0f }, { "lacunarity", &request.lacunarity, 0.001f, 10.0f },
+		{ "redis", &request.redis, 0.1f, 5.0f }, { "warp", &request.warp, 0.0f, 10.0f }, { "islandRange", &request.islandRange, 1.0f, 1000.0f },
+		{ "heightFromTop", &request.heightFromTop, 0.0f, 1.0f }, { "spawnFraction", &request.spawnFraction, 0.0f, 1.0f },
+	};
+
+	if (name == "seed")
+	{
+		long long seed = 0;
+		if (!ParseInt(value, 0, 0xffffffffll, seed))
+		{
+			error = "seed must be a whole number from 0 to 4294967295";
+			return false;
+		}
+
+		request.seed = (unsigned int)seed;
+		return true;
+	}
+
+	for (IntField& field : intFields)
+	{
+		if (name == field.name)
+		{
+			long long number = 0;
+			if (!ParseInt(value, field.min, field.max, number))
+			{
+				error = name + " must be a whole number from " + std::to_string(field.min) + " to " + std::to_string(field.max);
+				return false;
+			}
+
+			*field.field = (int)number;
+			if (name == "rivers")
+			{
+				rivers = riversFlag == 1;
+			}
+			return true;
+		}
+	}
+	for (FloatField& field : floatFields)
+	{
+		if (name == field.name)
+		{
+			if (!ParseFloat(value, field.min, field.max, *field.field))
+			{
+				char range[64];
+				snprintf(range, sizeof(range), " must be a number from %g to %g", field.min, field.max);
+				error = name + range;
+				return false;
+			}
+
+			return true;
+		}
+	}
+
+	error = "there is no field called " + name;
+	return false;
+}
+
+// Checks the fields that are fine on their own but not together
+// noise2 and pnoise2 cut each point to an int lattice cell, so the finest octave's coordinates have to fit in an int,
+// past that they overflow and the map comes out as NaN
+bool CheckNoiseRange(const GenerateRequest& request, std::string& error)
+{
+	// The furthest a point gets from 0, the map spans 10 units from its seed
+	double extent = std::max(fabs(request.xSeed), fabs(request.ySeed)) + 10.0;
+
+	// Warping samples the y warp 5.2 units over, and moves each point by up to warp * the FBM, noise2 stays within 1
+	if (request.warp > 0.0f)
+	{
+		double fbmRange = 0.0;
+		double amplitude = request.amplitude;
+		for (int i = 0; i < request.octaves; i++)
+		{
+			fbmRange += amplitude;
+			amplitude *= request.persistance;
+		}
+
+		extent += 5.2 + request.warp * fbmRange;
+	}
+
+	double finest = request.frequency * pow((double)request.lacunarity, request.octaves - 1);
+
+	// noise2 adds 4096 before cutting, to keep points positive
+	if (extent * finest + 4096.0 >= 2147483647.0)
+	{
+		error = "octaves, lacunarity, frequency, warp and the seeds together make the finest octave's coordinates too big, lower one of them";
+		return false;
+	}
+
+	return true;
+}
+
+// Reads the name=value pairs after the ? in a request path into request
+// Returns false, with why in error, if any of them can't be used
+bool ParseQuery(const std::string& query, GenerateRequest& request, bool& rivers, int maxSize, std::string& error)
+{
+	size_t start = 0;
+	while (start < query.size())
+	{
+		size_t end = query.find('&', start);
+		if (end == std::string::npos)
+		{
+			end = query.size();
+		}
+
+		std::string pair = query.substr(start, end - start);
+		size_t equals = pair.find('=');
+		if (equals == std::string::npos)
+		{
+			error = "expected name=value, got " + pair;
+			return false;
+		}
+		if (!SetRequestField(request, rivers, pair.substr(0, equals), pair.c_str() + equals + 1, maxSize, error))
+		{
+			return false;
+		}
+
+		start = end + 1;
+	}
+
+	return CheckNoiseRange(request, error);
+}
+
+TerrainServer::TerrainServer(const ServerSettings& serverSettings) : settings(serverSettings), listenSocket(INVALID_SOCKET), stopping(false)
+{
+	if (settings.workers <= 0)
+	{
+		settings.workers = 1;
+	}
+
+	latencies.reserve(latencySamples);
+}
+
+TerrainServer::~TerrainServer()
+{
+	Stop();
+}
+
+// Serves requests until Stop is called, returns false if the server couldn't start
+bool TerrainServer::Run()
+{
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		return false;
+	}
+
+	// Only listens on the loopback address, it's for programs on the same machine
+	SOCKET server = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(settings.port);
+
+	if (server == INVALID_SOCKET || bind(server, (sockaddr*)&address, sizeof(address)) != 0 || listen(server, SOMAXCONN) != 0)
+	{
+		if (server != INVALID_SOCKET)
+		{
+			closesocket(server);
+		}
+		WSACleanup();
+		return false;
+	}
+
+	listenSocket = server;
+
+	// The workers stay running, so their generators keep the noise tables and stages between requests
+	for (int i = 0; i < settings.workers; i++)
+	{
+		workers.push_back(std::unique_ptr<Worker>(new Worker()));
+	}
+	for (auto& worker : workers)
+	{
+		worker->thread = std::thread(&TerrainServer::WorkerLoop, this, worker.get());
+	}
+	batchThread = std::thread(&TerrainServer::BatchLoop, this);
+
+	AcceptLoop();
+
+	// Finishes the requests already read, then stops the workers
+	queueCondition.notify_all();
+	batchThread.join();
+	for (auto& worker : workers)
+	{
+		{
+			std::lock_guard<std::mutex> lock(worker->mutex);
+			worker->stop = true;
+		}
+		worker->condition.notify_all();
+		worker->thread.join();
+	}
+	workers.clear();
+
+	WSACleanup();
+	return true;
+}
+
+void TerrainServer::Stop()
+{
+	if (stopping.exchange(true))
+	{
+		return;
+	}
+
+	// Closing the socket makes accept return
+	if (listenSocket != INVALID_SOCKET)
+	{
+		closesocket((SOCKET)listenSocket);
+	}
+
+	std::lock_guard<std::mutex> lock(queueMutex);
+	queueCondition.notify_all();
+}
+
+// The latency of the most recent requests
+LatencyStats TerrainServer::Latency()
+{
+	std::lock_guard<std::mutex> lock(statsMutex);
+
+	LatencyStats result = stats;
+	if (latencies.empty())
+	{
+		return result;
+	}
+
+	std::vector<float> sorted = latencies;
+	std::sort(sorted.begin(), sorted.end());
+
+	result.p50 = sorted[(sorted.size() - 1) / 2];
+	result.p99 = sorted[(sorted.size() - 1) * 99 / 100];
+	result.max = sorted.back();
+
+	return result;
+}
+
+void TerrainServer::RecordLatency(float milliseconds)
+{
+	std::lock_guard<std::mutex> lock(statsMutex);
+
+	if (latencies.size() < latencySamples)
+	{
+		latencies.push_back(milliseconds);
+	}
+	else
+	{
+		latencies[nextLatency] = milliseconds;
+		nextLatency = (nextLatency + 1) % latencySamples;
+	}
+
+	stats.requests++;
+}
+
+void TerrainServer::AcceptLoop()
+{
+	while (!stopping)
+	{
+		SOCKET connection = accept((SOCKET)listenSocket, NULL, NULL);
+		if (connection == INVALID_SOCKET)
+		{
+			continue;
+		}
+
+		// Stops a client that never sends its request from holding up shutting down
+		DWORD timeout = 5000;
+		setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+		// Each connection waits on its own thread, the work itself is done by the workers
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			connections++;
+		}
+		std::thread(&TerrainServer::HandleConnection, this, (unsigned long long)connection).detach();
+	}
+}
+
+// Serves the connection, then closes it
+void TerrainServer::HandleConnection(unsigned long long connection)
+{
+	ServeConnection(connection);
+	closesocket((SOCKET)connection);
+
+	// The batcher doesn't stop until every connection is done with it
+	// Notifies while holding the lock, as the server can be destroyed as soon as it is released
+	std::lock_guard<std::mutex> lock(queueMutex);
+	connections--;
+	queueCondition.notify_all();
+}
+
+// Reads one request from the connection and replies to it
+void TerrainServer::ServeConnection(unsigned long long socketHandle)
+{
+	SOCKET connection = (SOCKET)socketHandle;
+
+	// Reads up to the end of the headers, the body isn't used
+	std::string text;
+	char buffer[1024];
+	while (text.find("\r\n\r\n") == std::string::npos && text.size() < 8192)
+	{
+		int received = recv(connection, buffer, sizeof(buffer), 0);
+		if (received <= 0)
+		{
+			return;
+		}
+		text.append(buffer, received);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	// GET /path?query HTTP/1.x
+	size_t pathStart = text.find(' ');
+	size_t pathEnd = text.find(' ', pathStart + 1);
+	if (text.compare(0, 4, "GET ") != 0 || pathEnd == std::string::npos)
+	{
+		SendText(connection, "400 Bad Request", "Only GET is supported\n");
+		return;
+	}
+
+	std::string path = text.substr(pathStart + 1, pathEnd - pathStart - 1);
+	std::string query;
+	size_t question = path.find('?');
+	if (question != std::string::npos)
+	{
+		query = path.substr(question + 1);
+		path = path.substr(0, question);
+	}
+
+	if (path == "/metrics")
+	{
+		LatencyStats latency = Latency();
+
+		char body[512];
+		sprintf_s(body, sizeof(body), "requests %llu\nbatches %llu\ncoalesced %llu\nmean_batch %.2f\np50_ms %.3f\np99_ms %.3f\nmax_ms %.3f\n",
+			latency.requests, latency.batches, latency.coalesced, latency.batches > 0 ? (float)latency.requests / latency.batches : 0.0f,
+			latency.p50, latency.p99, latency.max);
+
+		SendText(connection, "200 OK", body);
+		return;
+	}
+
+	if (path != "/generate")
+	{
+		SendText(connection, "404 Not Found", "Use /generate?field=value&... or /metrics\n");
+		return;
+	}
+
+	PendingRequest request;
+	std::string error;
+	if (!ParseQuery(query, request.request, request.rivers, settings.maxSize, error))
+	{
+		SendText(connection, "400 Bad Request", error + "\n");
+		return;
+	}
+
+	int size = request.request.size;
+
+	request.hash = RequestHash(request.request);
+	std::future<void> finished = request.finished.get_future();
+
+	// Hands the request to the batcher, and waits for a worker to fill it in
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		pending.push_back(&request);
+	}
+	queueCondition.notify_one();
+
+	// If generating failed the worker passes the exception on, and the client gets a 500 instead of waiting forever
+	try
+	{
+		finished.get();
+	}
+	catch (const std::exception& exception)
+	{
+		SendText(connection, "500 Internal Server Error", std::string("Couldn't generate the map: ") + exception.what() + "\n");
+		return;
+	}
+	catch (...)
+	{
+		SendText(connection, "500 Internal Server Error", "Couldn't generate the map\n");
+		return;
+	}
+
+	char header[256];
+	size_t mapBytes = (size_t)size * size * sizeof(float);
+	size_t bodyBytes = request.rivers ? mapBytes * 2 : mapBytes;
+	sprintf_s(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: %llu\r\nX-Rivers-Generated: %d\r\n\r\n",
+		(unsigned long long)bodyBytes, request.report.riversGenerated);
+
+	bool sent = SendAll(connection, header, strlen(header)) && SendAll(connection, (const char*)request.heights.data(), mapBytes);
+	if (sent && request.rivers)
+	{
+		sent = SendAll(connection, (const char*)request.riverMap.data(), mapBytes);
+	}
+
+	std::chrono::duration<float, std::milli> latency = std::chrono::steady_clock::now() - start;
+	RecordLatency(latency.count());
+}
+
+// Gathers the requests that arrive together, and hands them to the workers
+void TerrainServer::BatchLoop()
+{
+	while (true)
+	{
+		std::vector<PendingRequest*> batch;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this] { return !pending.empty() || (stopping && connections == 0); });
+			if (pending.empty())
+			{
+				return;
+			}
+
+			// Gives the requests sent at the same time a moment to arrive
+			queueCondition.wait_for(lock, std::chrono::milliseconds(settings.batchWindowMs), [this] { return (int)pending.size() >= settings.maxBatch || stopping; });
+
+			size_t count = std::min(pending.size(), (size_t)settings.maxBatch);
+			batch.assign(pending.begin(), pending.begin() + count);
+			pending.erase(pending.begin(), pending.begin() + count);
+		}
+
+		// Identical requests are generated once
+		std::map<unsigned long long, std::vector<PendingRequest*>> groups;
+		for (PendingRequest* request : batch)
+		{
+			groups[request->hash].push_back(request);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(statsMutex);
+			stats.batches++;
+			stats.coalesced += batch.size() - groups.size();
+		}
+
+		// Different requests that share the noise and the stages after it are put next to each other, so the worker
+		// generating them reuses those stages rather than each one starting over
+		std::vector<std::vector<PendingRequest*>*> order;
+		for (auto& group : groups)
+		{
+			order.push_back(&group.second);
+		}
+		std::stable_sort(order.begin(), order.end(), [](const std::vector<PendingRequest*>* a, const std::vector<PendingRequest*>* b)
+		{
+			return StageOrder((*a)[0]->request) < StageOrder((*b)[0]->request);
+		});
+
+		// Requests with the same seed go to the same worker, so its noise tables don't need setting up again
+		for (std::vector<PendingRequest*>* group : order)
+		{
+			Worker* worker = workers[(*group)[0]->request.seed % workers.size()].get();
+			{
+				std::lock_guard<std::mutex> lock(worker->mutex);
+				worker->jobs.push_back(*group);
+			}
+			worker->condition.notify_one();
+		}
+	}
+}
+
+// Generates the maps for each group of identical requests it is given
+void TerrainServer::WorkerLoop(Worker* worker)
+{
+	while (true)
+	{
+		std::vector<PendingRequest*> group;
+		{
+			std::unique_lock<std::mutex> lock(worker->mutex);
+			worker->condition.wait(lock, [worker] { return !worker->jobs.empty() || worker->stop; });
+			if (worker->jobs.empty())
+			{
+				return;
+			}
+
+			group = worker->jobs.front();
+			worker->jobs.pop_front();
+		}
+
+		// Generates straight into the first request's buffers
+		PendingRequest* first = group[0];
+		int size = first->request.size;
+
+		// Anything thrown, like running out of memory, is handed to every connection waiting on the group
+		try
+		{
+			first->heights.resize((size_t)size * size);
+			first->riverMap.resize((size_t)size * size);
+
+			TerrainBuffers buffers;
+			buffers.heights.data = first->heights.data();
+			buffers.heights.stride = size;
+			buffers.rivers.data = first->riverMap.data();
+			buffers.rivers.stride = size;
+
+			first->report = worker->generator.Generate(first->request, buffers);
+
+			// The ranges should stop it, but a map that still came out as NaN is an error rather than a reply
+			for (size_t i = 0; i < first->heights.size(); i++)
+			{
+				if (!std::isfinite(first->heights[i]) || !std::isfinite(first->riverMap[i]))
+				{
+					throw std::runtime_error("the map came out as NaN or infinite");
+				}
+			}
+
+			for (size_t i = 1; i < group.size(); i++)
+			{
+				group[i]->heights = first->heights;
+				group[i]->riverMap = first->riverMap;
+				group[i]->report = first->report;
+			}
+		}
+		catch (...)
+		{
+			// Most likely it ran out of memory, so it lets go of what it was keeping too
+			worker->generator.FreeStages();
+
+			std::exception_ptr exception = std::current_exception();
+			for (PendingRequest* request : group)
+			{
+				request->finished.set_exception(exception);
+			}
+			continue;
+		}
+
+		// Big maps' stages would hold too much memory until this worker's next request
+		if (size > settings.maxCachedSize)
+		{
+			worker->generator.FreeStages();
+		}
+
+		for (PendingRequest* request : group)
+		{
+			request->finished.set_value();
+		}
+	}
+}
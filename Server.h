@@ -0,0 +1,115 @@
+/*
+	Local generation server
+
+	Keeps the generator running so a game backend doesn't pay for process startup, GDI+ and
+	setting up the noise tables on every map. Listens for HTTP on the loopback address:
+
+	GET /generate?size=256&seed=12&octaves=6...
+		Any GenerateRequest field can be given by name, anything left out uses the default
+		Add rivers=1 to get the river map after the height map
+		Replies with the maps as size * size little endian floats, row by row
+
+	GET /metrics
+		Replies with the request counts, batch sizes and p50/p99 latency as text
+
+	Requests that arrive within batchWindowMs of each other are gathered into a batch. Identical
+	requests in a batch are generated once and share the result. The rest are sorted by their fields
+	in the order the stages use them, and requests with the same seed go to the same worker, so
+	requests that share the noise (and maybe the island or erosion after it) run back to back and
+	the worker's generator only reruns the stages where they differ.
+
+	The workers' loops all run on the one shared thread pool (see Parallel.h), so the workers split
+	the cores rather than each using all of them.
+*/
+
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+#include "Terrain.h"
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+struct ServerSettings
+{
+	unsigned short port = 8037;
+
+	// Each worker generates one map at a time, with its loops spread over the shared thread pool
+	// A second worker keeps the cores busy through the other's single threaded parts, like tracing rivers
+	int workers = 2;
+
+	// How long to wait for more requests to batch with the first one, and the most in a batch
+	int batchWindowMs = 2;
+	int maxBatch = 64;
+
+	// The biggest map a request can ask for
+	int maxSize = 4096;
+
+	// Workers keep the stages of maps up to this size for the next request, bigger ones are freed once generated
+	// The stages take about 56 bytes a pixel, so each worker holds at most ~59MB at 1024, against ~940MB at 4096
+	int maxCachedSize = 1024;
+};
+
+// Latencies in milliseconds, from a request being read to its reply being sent
+struct LatencyStats
+{
+	unsigned long long requests = 0;
+	unsigned long long batches = 0;
+
+	// Requests that were served by generating an identical request in the same batch
+	unsigned long long coalesced = 0;
+
+	float p50 = 0.0f;
+	float p99 = 0.0f;
+	float max = 0.0f;
+};
+
+class TerrainServer
+{
+public:
+	TerrainServer(const ServerSettings& settings);
+	~TerrainServer();
+
+	// Serves requests until Stop is called, returns false if the server couldn't start
+	bool Run();
+	void Stop();
+
+	// The latency of the most recent requests
+	LatencyStats Latency();
+
+private:
+	struct PendingRequest;
+	struct Worker;
+
+	void AcceptLoop();
+	void HandleConnection(unsigned long long connection);
+	void ServeConnection(unsigned long long connection);
+	void BatchLoop();
+	void WorkerLoop(Worker* worker);
+	void RecordLatency(float milliseconds);
+
+	ServerSettings settings;
+	unsigned long long listenSocket;
+	std::atomic<bool> stopping;
+
+	// Requests waiting to be batched
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::vector<PendingRequest*> pending;
+	int connections = 0;
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::thread batchThread;
+
+	// The last latencySamples request latencies, oldest overwritten first
+	std::mutex statsMutex;
+	std::vector<float> latencies;
+	size_t nextLatency = 0;
+	LatencyStats stats;
+};
+
+#endif
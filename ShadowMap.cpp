@@ -0,0 +1,131 @@
+#include "ShadowMap.h"
+#include "Parallel.h"
+#include <math.h>
+
+// A point already passed on the current line, at distance along the line and height
+struct HullPoint
+{
+	float distance;
+	float height;
+};
+
+// The slope from (distance, height) up to point
+static inline float Slope(float distance, float height, const HullPoint& point)
+{
+	return (point.height - height) / (distance - point.distance);
+}
+
+void HorizonMap(float** map, int xSize, int ySize, float azimuth, float cellSize, float heightScale, std::vector<float>& horizon)
+{
+	horizon.assign(xSize * ySize, 0.0f);
+
+	float radians = azimuth * 3.14159265f / 180.0f;
+	float dirX = cosf(radians);
+	float dirY = sinf(radians);
+
+	// Steps one cell at a time along the longer axis, and a fraction of a cell along the other
+	// The cells are split into lines by rounding, so every cell is on exactly one line
+	bool xMajor = fabsf(dirX) >= fabsf(dirY);
+	int length = xMajor ? xSize : ySize;
+	int width = xMajor ? ySize : xSize;
+	float major = xMajor ? dirX : dirY;
+	float minor = xMajor ? dirY : dirX;
+	float slope = minor / major;
+	float stepLength = sqrtf(1.0f + slope * slope) * cellSize;
+
+	// Starts from the end nearest the light, so every cell has already passed the cells it can be shadowed by
+	int start = (major > 0) ? length - 1 : 0;
+	int step = (major > 0) ? -1 : 1;
+
+	// Lines that start off the side of the map still cross into it
+	int spread = (int)ceilf(fabsf(slope) * length) + 1;
+
+	ParallelFor(width + spread * 2, [&](int line)
+	{
+		int offset = line - spread;
+		std::vector<HullPoint> hull;
+
+		for (int i = 0; i < length; i++)
+		{
+			int along = start + i * step;
+			int across = offset + (int)floorf(along * slope + 0.5f);
+
+			if (across < 0 || across >= width)
+			{
+				continue;
+			}
+
+			int x = xMajor ? along : across;
+			int y = xMajor ? across : along;
+
+			HullPoint point;
+			point.distance = i * stepLength;
+			point.height = map[y][x] * heightScale;
+
+			// Keeps the upper convex hull of the points passed, the horizon is the steepest slope up to it
+			while (hull.size() >= 2 && Slope(point.distance, point.height, hull[hull.size() - 1]) <= Slope(point.distance, point.height, hull[hull.size() - 2]))
+			{
+				hull.pop_back();
+			}
+
+			if (!hull.empty())
+			{
+				float tangent = Slope(point.distance, point.height, hull.back());
+				horizon[y * xSize + x] = (tangent > 0.0f) ? tangent : 0.0f;
+			}
+
+			hull.push_back(point);
+		}
+	});
+}
+
+void BakeShadowMap(float** map, int xSize, int ySize, const ShadowSettings& settings, float** light1, float** light2, float** occlusion)
+{
+	float cellSize = settings.worldSize / (xSize - 1);
+	std::vector<float> horizon;
+
+	// Lit if the light is above the horizon, softened over a couple of degrees so the shadow edges aren't jagged
+	float** lights[2] = { light1, light2 };
+	for (int l = 0; l < 2; l++)
+	{
+		HorizonMap(map, xSize, ySize, settings.lightAzimuth[l], cellSize, settings.heightScale, horizon);
+
+		float elevation = settings.lightElevation[l];
+		float penumbra = 2.0f;
+
+		ParallelFor(ySize, [&](int y)
+		{
+			for (int x = 0; x < xSize; x++)
+			{
+				float horizonAngle = atanf(horizon[y * xSize + x]) * 180.0f / 3.14159265f;
+				float lit = (elevation - horizonAngle) / penumbra + 0.5f;
+
+				lights[l][y][x] = fminf(1.0f, fmaxf(0.0f, lit));
+			}
+		});
+	}
+
+	// Ambient occlusion, the average of how much sky is above the horizon in each direction
+	for (int y = 0; y < ySize; y++)
+	{
+		for (int x = 0; x < xSize; x++)
+		{
+			occlusion[y][x] = 0.0f;
+		}
+	}
+
+	for (int d = 0; d < settings.occlusionDirections; d++)
+	{
+		HorizonMap(map, xSize, ySize, 360.0f * d / settings.occlusionDirections, cellSize, settings.heightScale, horizon);
+
+		ParallelFor(ySize, [&](int y)
+		{
+			for (int x = 0; x < xSize; x++)
+			{
+				// 1 - sin(angle), worked out from the tangent
+				float tangent = horizon[y * xSize + x];
+				occlusion[y][x] += (1.0f - tangent / sqrtf(1.0f + tangent * tangent)) / settings.occlusionDirections;
+			}
+		});
+	}
+}
@@ -0,0 +1,37 @@
+/*
+	Baked shadows and ambient occlusion for static terrain
+
+	For a direction across the map, the horizon at a cell is the steepest slope up to any cell
+	further along in that direction. A cell is lit by a light in that direction if the light is
+	higher than the horizon, and the higher the horizons all around a cell, the less sky it sees.
+*/
+
+#ifndef _SHADOWMAP_H_
+#define _SHADOWMAP_H_
+
+#include <vector>
+
+// The two directional lights, and the size of the terrain they light
+struct ShadowSettings
+{
+	// Degrees, azimuth is measured from the +x axis of the map towards +y
+	float lightAzimuth[2] = { 45.0f, 225.0f };
+	float lightElevation[2] = { 30.0f, 60.0f };
+
+	// How many directions ambient occlusion looks in
+	int occlusionDirections = 8;
+
+	// The size of the map in world units, and the height of a cell at 1
+	float worldSize = 64.0f;
+	float heightScale = 10.0f;
+};
+
+// Works out the horizon for every cell looking towards azimuth degrees, as the tangent of its angle above flat
+// horizon is xSize * ySize, row by row. Each line across the map is swept once, so it takes time proportional to the map size
+void HorizonMap(float** map, int xSize, int ySize, float azimuth, float cellSize, float heightScale, std::vector<float>& horizon);
+
+// Bakes how lit each cell is by each light (0 to 1), and the ambient occlusion (1 is fully open)
+// The outputs are xSize by ySize grids made by the caller
+void BakeShadowMap(float** map, int xSize, int ySize, const ShadowSettings& settings, float** light1, float** light2, float** occlusion);
+
+#endif
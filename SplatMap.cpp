@@ -0,0 +1,118 @@
+#include "SplatMap.h"
+#include "Parallel.h"
+#include <math.h>
+
+// The height of the displaced terrain at (x, y), clamped to the edges, as tessellation_ds.hlsl displaces it
+static float DisplacedHeight(float** heightMap, int xSize, int ySize, int x, int y, const SplatSettings& s)
+{
+	if (x < 0) x = 0;
+	if (y < 0) y = 0;
+	if (x > xSize - 1) x = xSize - 1;
+	if (y > ySize - 1) y = ySize - 1;
+
+	float height = heightMap[y][x];
+	if (height < s.waterLevel)
+	{
+		height = s.waterLevel;
+	}
+
+	return (height - s.waterLevel) * s.heightScale;
+}
+
+void BakeSplatMap(float** heightMap, float** riverMap, int xSize, int ySize, const SplatSettings& settings, float** splat, float** water, float** normals)
+{
+	float cellSize = settings.worldSize / (xSize - 1);
+	float waterLevel = settings.waterLevel;
+	float heightLevel = settings.heightLevel;
+
+	ParallelFor(ySize, [&](int y)
+	{
+		for (int x = 0; x < xSize; x++)
+		{
+			// Normal from the slope either side
+			float dX = (DisplacedHeight(heightMap, xSize, ySize, x + 1, y, settings) - DisplacedHeight(heightMap, xSize, ySize, x - 1, y, settings)) / (2 * cellSize);
+			float dZ = (DisplacedHeight(heightMap, xSize, ySize, x, y + 1, settings) - DisplacedHeight(heightMap, xSize, ySize, x, y - 1, settings)) / (2 * cellSize);
+
+			float length = sqrtf(dX * dX + 1.0f + dZ * dZ);
+			float normalX = -dX / length;
+			float normalY = 1.0f / length;
+			float normalZ = -dZ / length;
+
+			// The angle from straight up, in radians
+			float angle = acosf(normalY);
+
+			float height = heightMap[y][x];
+			float river = riverMap[y][x];
+
+			// The pixel shader looks this up with u and v swapped, so row u * ySize and column v * xSize
+			// Going through the texture coordinates keeps it inside the map when it isn't square
+			float offset = heightMap[(int)((long long)x * ySize / xSize)][(int)((long long)y * xSize / ySize)];
+
+			// The pixel shader's blend, worked through as weights:
+			// heightTex = grass * (1 - heightValue) + rock * heightValue
+			// terrainTex = (0.5 * (grass * (1 - angle) + heightTex * angle) + heightTex) / 1.5
+			float heightValue = (height - waterLevel + 0.2f) * heightLevel;
+			if (heightValue > 1.0f)
+			{
+				heightValue = 1.0f;
+			}
+
+			float rock = (0.5f * angle * heightValue + heightValue) / 1.5f;
+			rock = fminf(1.0f, fmaxf(0.0f, rock));
+
+			float grass = 1.0f - rock;
+			float sand = 0.0f;
+			float sea = 0.0f;
+			float riverWater = 0.0f;
+
+			// Beaches & riverbanks
+			if ((height > waterLevel && height < waterLevel + ((offset / heightLevel) / 20.0f) + 0.01f) || river - (powf(height, 2.5f) * heightLevel) >= 0.6f - waterLevel)
+			{
+				grass = 0.0f;
+				rock = 0.0f;
+				sand = 1.0f;
+			}
+
+			// Rivers, the sea is coloured over them
+			if (river - powf(height, 1.5f) >= 0.69f - waterLevel || river >= (0.76f + height / 20.0f - waterLevel / 10.0f))
+			{
+				grass = 0.0f;
+				rock = 0.0f;
+				sand = 0.0f;
+				riverWater = 1.0f;
+			}
+
+			// The sea
+			if (height <= waterLevel)
+			{
+				grass = 0.0f;
+				rock = 0.0f;
+				sand = 0.0f;
+				riverWater = 0.0f;
+				sea = 1.0f;
+			}
+
+			// The colour of the water below waterLevel, green goes below 0 for deep water and blue never goes below 0.8
+			float green = (height - (waterLevel - 0.2f)) * 2.0f;
+			green = floorf(green * 10.0f) / 10.0f;
+			float blue = fmaxf(0.8f, 1.0f + green);
+
+			float* splatPixel = &splat[y][x * 4];
+			splatPixel[0] = grass;
+			splatPixel[1] = rock;
+			splatPixel[2] = sand;
+			splatPixel[3] = sea + riverWater;
+
+			float* waterPixel = &water[y][x * 4];
+			waterPixel[0] = sea;
+			waterPixel[1] = riverWater;
+			waterPixel[2] = fminf(1.0f, fmaxf(0.0f, green));
+			waterPixel[3] = fminf(1.0f, blue);
+
+			float* normalPixel = &normals[y][x * 3];
+			normalPixel[0] = normalX;
+			normalPixel[1] = normalY;
+			normalPixel[2] = normalZ;
+		}
+	});
+}
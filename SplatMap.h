@@ -0,0 +1,31 @@
+/*
+	Baked terrain blending, so the renderer doesn't have to work it out every frame
+
+	Works out the same grass, rock, sand and water blend as tessellation_ps.hlsl, from the height
+	map, the river map and the slope, and stores it as weights in a splat map. The water gets a
+	map of its own, keeping rivers and the sea apart as the pixel shader colours them differently.
+	The normals are worked out in the same pass, as the slope needs them anyway.
+*/
+
+#ifndef _SPLATMAP_H_
+#define _SPLATMAP_H_
+
+// The values tessellation_ps.hlsl gets from its constant buffer, and the size of the terrain
+struct SplatSettings
+{
+	float waterLevel = 0.3f;
+	float heightLevel = 1.0f;
+
+	// The size of the map in world units, and the height of a cell at 1, as in tessellation_ds.hlsl
+	float worldSize = 64.0f;
+	float heightScale = 10.0f;
+};
+
+// Bakes the splat, water and normal maps in one pass
+// splat is ySize rows of xSize * 4 floats, the grass, rock, sand and water weights of each pixel, adding up to 1
+// water is ySize rows of xSize * 4 floats, the sea and river weights of each pixel, which add up to its water weight,
+// then the green and blue the pixel shader gives the sea there
+// normals is ySize rows of xSize * 3 floats, the normal of each pixel
+void BakeSplatMap(float** heightMap, float** riverMap, int xSize, int ySize, const SplatSettings& settings, float** splat, float** water, float** normals);
+
+#endif
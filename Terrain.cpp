@@ -0,0 +1,1471 @@
+/*
+	Terrain generation library
+
+	The noise, island, erosion, river and blur stages of the generator, and the cache that keeps
+	them between maps. See Terrain.h
+*/
+
+#include "Terrain.h"
+#include "PerlinNoiseClass.h"
+#include "NoiseCache.h"
+#include "Erosion.h"
+#include "Parallel.h"
+#include "Pipeline.h"
+#include "Reductions.h"
+#include <iostream>
+#include <time.h>
+#include <stdlib.h>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <queue>
+#include <functional>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// Rows in each band passed through the pipelines
+const int bandRows = 32;
+
+// A cached pipeline stage, its grids are reused while hash matches the hash of the stage's inputs
+// If the grids were mapped from the disk cache, mapped holds the mapping instead of them being owned
+struct CachedStage
+{
+	unsigned long long hash = 0;
+	float** grid = nullptr;
+	float** gridSimple = nullptr;
+	MappedGrid mapped;
+};
+
+// Everything kept between generations, so changing a parameter only reruns the stages after it
+struct PipelineCache
+{
+	PerlinNoiseClass perlinNoise;
+	unsigned int seed = 0;
+	bool seeded = false;
+
+	CachedStage raw;
+	CachedStage scaled;
+	CachedStage redistributed;
+	CachedStage island;
+	CachedStage eroded;
+	CachedStage thermal;
+	CachedStage rivers;
+	CachedStage blur;
+
+	// How many rivers the cached river map has
+	int riversGenerated = 0;
+};
+
+struct Vector2
+{
+	int x = 0;
+	int y = 0;
+};
+
+// The values of a single FBM octave, worked out once and shared by every point that uses them
+struct Octave
+{
+	float amplitude = 0.0f;
+	float frequency = 0.0f;
+	int period = 0;
+};
+
+// The Moore neighbourhood, in the order rivers check it
+const int neighbourX[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+const int neighbourY[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+
+// Rounds an octave to a whole number of lattice cells across the tile, so it wraps
+int OctavePeriod(float tileSize, float frequency)
+{
+	int period = (int)(tileSize * frequency + 0.5f);
+	if (period < 1)
+	{
+		period = 1;
+	}
+
+	return period;
+}
+
+// Gets the perlin noise value at x, y, with various modifiers
+// If tileSize is above 0 the noise repeats every tileSize units in x and y
+float FBM(PerlinNoiseClass& p, float x, float y, float ampl, float freq, float pers, float lacu, int oct, int ridged, float tileSize)
+{
+	float amplitude = ampl;
+	float frequency = freq;
+
+	float persistance = pers;
+	float lacunarity = lacu;
+
+	int octaves = oct;
+
+	float num = 0.0f;
+	float vec[2];
+	
+	float sum = 0.0f;
+
+	// Based off of http://flafla2.github.io/2014/08/09/perlinnoise.html
+	 
+	for (int i = 0; i < octaves; i++)
+	{	
+		if (tileSize > 0.0f)
+		{
+			int period = OctavePeriod(tileSize, frequency);
+
+			vec[0] = x * (period / tileSize);
+			vec[1] = y * (period / tileSize);
+
+			num = p.pnoise2(vec, period, period);
+		}
+		else
+		{
+			vec[0] = x * frequency;
+			vec[1] = y * frequency;
+
+			num = p.noise2(vec);
+		}
+
+		sum += amplitude * num;
+
+		amplitude *= persistance;
+		frequency *= lacunarity;
+	}
+
+	switch (ridged)
+	{
+	case 0:
+		return sum;
+	case 1:
+		return fabs(sum);
+	case 2:
+		return 1 - fabs(sum);
+	}
+
+	//return sum;// 1 - abs(sum);
+}
+
+// Works out the amplitude, frequency and wrap period of each octave, as FBM does for every point
+std::vector<Octave> SetupOctaves(float ampl, float freq, float pers, float lacu, int oct, float tileSize)
+{
+	std::vector<Octave> octaves(oct);
+
+	float amplitude = ampl;
+	float frequency = freq;
+
+	for (int i = 0; i < oct; i++)
+	{
+		octaves[i].amplitude = amplitude;
+		octaves[i].frequency = frequency;
+
+		// Snaps the frequency so the octave wraps across the tile
+		if (tileSize > 0.0f)
+		{
+			octaves[i].period = OctavePeriod(tileSize, frequency);
+			octaves[i].frequency = octaves[i].period / tileSize;
+		}
+
+		amplitude *= pers;
+		frequency *= lacu;
+	}
+
+	return octaves;
+}
+
+// Adds numOctaves octaves of noise at each of the count points in xs, ys to out
+// Loops over the points inside each octave, so the octave values are only looked up once
+void SumOctavesRow(PerlinNoiseClass& p, const std::vector<Octave>& octaves, int numOctaves, const float* xs, const float* ys, float* out, int count)
+{
+	float vec[2];
+
+	for (int i = 0; i < numOctaves; i++)
+	{
+		const Octave& octave = octaves[i];
+
+		if (octave.period > 0)
+		{
+			for (int x = 0; x < count; x++)
+			{
+				vec[0] = xs[x] * octave.frequency;
+				vec[1] = ys[x] * octave.frequency;
+
+				out[x] += octave.amplitude * p.pnoise2(vec, octave.period, octave.period);
+			}
+		}
+		else
+		{
+			for (int x = 0; x < count; x++)
+			{
+				vec[0] = xs[x] * octave.frequency;
+				vec[1] = ys[x] * octave.frequency;
+
+				out[x] += octave.amplitude * p.noise2(vec);
+			}
+		}
+	}
+}
+
+// Applies the ridged modifier from FBM to a row of summed octaves
+void RidgeRow(float* out, int count, int ridged)
+{
+	for (int x = 0; x < count; x++)
+	{
+		switch (ridged)
+		{
+		case 1:
+			out[x] = fabs(out[x]);
+			break;
+		case 2:
+			out[x] = 1 - fabs(out[x]);
+			break;
+		}
+	}
+}
+
+// Gets the FBM value of a row of count points, matches calling FBM on each point
+void FBMRow(PerlinNoiseClass& p, const std::vector<Octave>& octaves, int numOctaves, const float* xs, const float* ys, float* out, int count, int ridged)
+{
+	for (int x = 0; x < count; x++)
+	{
+		out[x] = 0.0f;
+	}
+
+	SumOctavesRow(p, octaves, numOctaves, xs, ys, out, count);
+	RidgeRow(out, count, ridged);
+}
+
+// Domain warped FBM along a row, q = fbm(p), result = fbm(p + warp * q)
+// The warp and the base evaluations share the same octaves, so it costs about 3 plain FBM rows
+void WarpedFBMRow(PerlinNoiseClass& p, const std::vector<Octave>& octaves, int numOctaves, const float* xs, const float* ys, float* out, int count, int ridged, float warp)
+{
+	std::vector<float> qx(count, 0.0f);
+	std::vector<float> qy(count, 0.0f);
+	std::vector<float> offsetX(count);
+	std::vector<float> offsetY(count);
+
+	// Samples the y warp away from the x warp, so the two aren't the same
+	for (int x = 0; x < count; x++)
+	{
+		offsetX[x] = xs[x] + 5.2f;
+		offsetY[x] = ys[x] + 1.3f;
+	}
+
+	SumOctavesRow(p, octaves, numOctaves, xs, ys, qx.data(), count);
+	SumOctavesRow(p, octaves, numOctaves, offsetX.data(), offsetY.data(), qy.data(), count);
+
+	// Moves each point by the warp
+	for (int x = 0; x < count; x++)
+	{
+		offsetX[x] = xs[x] + warp * qx[x];
+		offsetY[x] = ys[x] + warp * qy[x];
+	}
+
+	FBMRow(p, octaves, numOctaves, offsetX.data(), offsetY.data(), out, count, ridged);
+}
+
+// Makes the map into an island, using the equation of a circle
+float islandify(float xTarget, float yTarget, float xNum, float yNum, float maxDist)
+{	
+	// Manhatan distance between (xTarget, yTarget) and (xNum, yNum)
+	float dist = sqrtf(pow((xTarget) - xNum, 2) + pow((yTarget) - yNum, 2));
+
+	// Stops the concentric rings
+	if (dist > maxDist)
+	{ 
+		dist = maxDist;
+	}
+
+	// Convert distance to a value between 0 and 90
+	float toNinety = (dist/maxDist) * 90.0f;
+	// Convert this to radiens
+	float toRadien = (toNinety * 3.14f) / 180;
+	// Circle stuff
+	float convert = cos(sin(toRadien)) * 2.0f;
+	
+	return convert - 1.0f;
+}
+
+// Initialises a float** array to xSize by ySize, and sets all values to 0.0f
+// The rows are stored one after another in a single block, starting at grid[0]
+float**  InitGrid(int xSize, int ySize)
+{
+	float** grid = new float*[ySize];
+
+	grid[0] = new float[(size_t)xSize * ySize];
+	for (int i = 1; i < ySize; ++i)
+	{
+		grid[i] = grid[0] + (size_t)i * xSize;
+	}
+
+	for (int i = 0; i < xSize; i++)
+	{
+		for (int j = 0; j < ySize; j++)
+		{
+			grid[j][i] = 0.0f;
+		}
+	}
+	return grid;
+}
+
+// Deletes a float** array made by InitGrid
+void DeleteGrid(float** grid)
+{
+	delete[] grid[0];
+	delete[] grid;
+}
+
+// Makes a new xSize by ySize copy of grid
+float** CopyGrid(float** grid, int xSize, int ySize)
+{
+	float** copy = InitGrid(xSize, ySize);
+	memcpy(copy[0], grid[0], (size_t)xSize * ySize * sizeof(float));
+
+	return copy;
+}
+
+// Mixes the bytes of value into an FNV-1a hash
+template <typename T>
+unsigned long long HashValue(unsigned long long hash, T value)
+{
+	const unsigned char* bytes = (const unsigned char*)&value;
+
+	for (int i = 0; i < sizeof(T); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+// The starting value for HashValue
+const unsigned long long hashStart = 14695981039346656037ull;
+
+// Frees the grids held by a cached stage
+void ClearStage(CachedStage& stage)
+{
+	if (stage.mapped.view != NULL)
+	{
+		ReleaseMappedGrid(stage.mapped);
+	}
+	else
+	{
+		if (stage.grid != nullptr)
+		{
+			DeleteGrid(stage.grid);
+		}
+		if (stage.gridSimple != nullptr)
+		{
+			DeleteGrid(stage.gridSimple);
+		}
+	}
+
+	stage.grid = nullptr;
+	stage.gridSimple = nullptr;
+}
+
+// Replaces the grids held by a cached stage
+void StoreStage(CachedStage& stage, unsigned long long hash, float** grid, float** gridSimple)
+{
+	ClearStage(stage);
+
+	stage.hash = hash;
+	stage.grid = grid;
+	stage.gridSimple = gridSimple;
+}
+
+// Replaces the grids held by a cached stage with ones mapped from the disk cache
+void StoreMappedStage(CachedStage& stage, unsigned long long hash, MappedGrid& mapped)
+{
+	ClearStage(stage);
+
+	stage.hash = hash;
+	stage.mapped = mapped;
+	stage.grid = mapped.grid;
+	stage.gridSimple = mapped.gridSimple;
+}
+
+// Returns true if the stage holds grids made from inputs matching hash
+bool StageValid(CachedStage& stage, unsigned long long hash)
+{
+	return stage.grid != nullptr && stage.hash == hash;
+}
+
+// Scales value from between min and max to between 0 and 1
+// A flat map has no range to scale by, so it's all 0 rather than 0 / 0
+float ScaleHeight(float value, float min, float max)
+{
+	if (max > min)
+	{
+		return (value - min) / (max - min);
+	}
+
+	return 0.0f;
+}
+
+// Scales the xSize by ySize perlinArray so that the highest value is 1 an dth elowest is 0
+// Grids are a single block, so perlinArray[0] is a view of the whole map
+float** Scale(float** perlinArray, int xSize, int ySize)
+{
+	HeightRange range = ReduceRange(perlinArray[0], xSize, xSize, ySize);
+	float min = range.min;
+	float max = range.max;
+
+	// Scales the array
+	for (int x = 0; x < xSize; x++)
+	{
+		for (int y = 0; y < ySize; y++)
+		{
+			perlinArray[y][x] = ScaleHeight(perlinArray[y][x], min, max);
+		}
+	}
+
+	return perlinArray;
+}
+
+// Bins in the histogram used for equalising the heights
+const int equaliseBins = 4096;
+
+// Works out the curve that flattens the heights counted in histogram, which ran from 0 to 1
+// curve[b] is the fraction of the map in the bins below b, so it goes from 0 to 1
+std::vector<float> EqualiseCurve(const std::vector<unsigned int>& histogram)
+{
+	std::vector<float> curve(histogram.size() + 1);
+
+	double total = 0.0;
+	for (int bin = 0; bin < histogram.size(); bin++)
+	{
+		total += histogram[bin];
+	}
+
+	double below = 0.0;
+	curve[0] = 0.0f;
+	for (int bin = 0; bin < histogram.size(); bin++)
+	{
+		below += histogram[bin];
+		curve[bin + 1] = (float)(below / total);
+	}
+
+	return curve;
+}
+
+// Moves a height from 0 to 1 along an equalising curve, 0 and 1 stay where they are
+float EqualiseHeight(const std::vector<float>& curve, float height)
+{
+	int bins = curve.size() - 1;
+
+	float position = height * bins;
+	int bin = std::max(0, std::min((int)position, bins - 1));
+	float along = position - bin;
+
+	return curve[bin] * (1.0f - along) + curve[bin + 1] * along;
+}
+
+// Fills every pit in map, so that from any cell there is a path downhill to the edge or the sea
+// Uses priority flood, starting from the outlets and working inwards from the lowest cell, raising each cell to just above
+// the cell it was reached from if it is lower. Every filled cell then has a neighbour strictly lower than itself
+// If tileable is 1 there are no edges, so only the lowest cells are outlets
+float** FillDepressions(float** map, int xSize, int ySize, int tileable)
+{
+	float** filled = CopyGrid(map, xSize, ySize);
+	std::vector<bool> closed((size_t)xSize * ySize, false);
+
+	// Lowest height first
+	typedef std::pair<float, size_t> Cell;
+	std::priority_queue<Cell, std::vector<Cell>, std::greater<Cell>> open;
+
+	// Adds an outlet to the queue, unless it's already there
+	auto addOutlet = [&](int x, int y)
+	{
+		size_t index = (size_t)y * xSize + x;
+		if (!closed[index])
+		{
+			closed[index] = true;
+			open.push(Cell(map[y][x], index));
+		}
+	};
+
+	// Every border cell is an outlet, as water can run off the edge of the map
+	if (tileable == 0)
+	{
+		for (int x = 0; x < xSize; x++)
+		{
+			addOutlet(x, 0);
+			addOutlet(x, ySize - 1);
+		}
+		for (int y = 0; y < ySize; y++)
+		{
+			addOutlet(0, y);
+			addOutlet(xSize - 1, y);
+		}
+	}
+
+	// So is the sea, the lowest cells, which are the only outlets on a tiling map
+	float lowest = ReduceRange(map[0], xSize, xSize, ySize).min;
+	for (int y = 0; y < ySize; y++)
+	{
+		for (int x = 0; x < xSize; x++)
+		{
+			if (map[y][x] <= lowest)
+			{
+				addOutlet(x, y);
+			}
+		}
+	}
+
+	while (!open.empty())
+	{
+		Cell cell = open.top();
+		open.pop();
+
+		int x = (int)(cell.second % xSize);
+		int y = (int)(cell.second / xSize);
+
+		// Moore neighbourhood
+		for (int i = -1; i <= 1; i++)
+		{
+			for (int j = -1; j <= 1; j++)
+			{
+				int xNeighbour = x + i;
+				int yNeighbour = y + j;
+
+				// Wraps to the other side of the map
+				if (tileable == 1)
+				{
+					xNeighbour = (xNeighbour + xSize) % xSize;
+					yNeighbour = (yNeighbour + ySize) % ySize;
+				}
+
+				if (xNeighbour < 0 || yNeighbour < 0 || xNeighbour >= xSize || yNeighbour >= ySize)
+				{
+					continue;
+				}
+
+				size_t index = (size_t)yNeighbour * xSize + xNeighbour;
+				if (closed[index])
+				{
+					continue;
+				}
+				closed[index] = true;
+
+				// Raises pits to the smallest float above the cell they drain into
+				float drain = nextafterf(cell.first, 2.0f);
+				if (filled[yNeighbour][xNeighbour] < drain)
+				{
+					filled[yNeighbour][xNeighbour] = drain;
+				}
+
+				open.push(Cell(filled[yNeighbour][xNeighbour], index));
+			}
+		}
+	}
+
+	return filled;
+}
+
+// Moves x, y to its highest neighbour in map, or its lowest if uphill is false
+// Returns false if no neighbour is higher (or lower), so x, y is a peak (or an outlet)
+// If tileable is 1 the neighbours wrap around the edges of the map
+bool StepRiver(float** map, int xSize, int ySize, int tileable, bool uphill, int& x, int& y)
+{
+	float best = map[y][x];
+	int xBest = -1;
+	int yBest = -1;
+
+	for (int i = 0; i < 8; i++)
+	{
+		int xNeighbour = x + neighbourX[i];
+		int yNeighbour = y + neighbourY[i];
+
+		// Wraps to the other side of the map
+		if (tileable == 1)
+		{
+			xNeighbour = (xNeighbour + xSize) % xSize;
+			yNeighbour = (yNeighbour + ySize) % ySize;
+		}
+		else if (xNeighbour < 0 || yNeighbour < 0 || xNeighbour >= xSize || yNeighbour >= ySize)
+		{
+			continue;
+		}
+
+		float height = map[yNeighbour][xNeighbour];
+		if (uphill ? height > best : height < best)
+		{
+			best = height;
+			xBest = xNeighbour;
+			yBest = yNeighbour;
+		}
+	}
+
+	if (xBest == -1)
+	{
+		return false;
+	}
+
+	x = xBest;
+	y = yBest;
+	return true;
+}
+
+// Generates a number of rivers, with a minimum length 
+// Rivers start from points within heightFromTop of the highest point, or if spawnFraction is above 0, from the highest
+// spawnFraction of the map
+// The paths are traced straight over the filled height map, so the only memory needed past the maps is the start points
+// riversGenerated is set to how many rivers were long enough to keep
+float** GenerateRivers(float** map, int xSize, int ySize, int numberOfRivers, int minRiverLength, float heightFromTop, float spawnFraction, int betterGen, int tileable, int& riversGenerated)
+{
+	// Initialise the random number generator
+	std::random_device rd;
+	std::mt19937 gen(rd());
+
+	// Create the output map
+	float** riverMap;
+	riverMap = InitGrid(xSize, ySize);
+
+	riversGenerated = 0;
+
+	// No rivers, so there's no need to work out where they could go
+	if (numberOfRivers <= 0)
+	{
+		return riverMap;
+	}
+
+	// Fills the pits, so the rivers don't stop in them
+	float** filledMap = FillDepressions(map, xSize, ySize, tileable);
+
+	std::vector<Vector2> highPoints;
+
+	// Finds the height rivers can start above
+	float spawnHeight = 0.0f;
+	if (spawnFraction > 0.0f)
+	{
+		spawnHeight = ReducePercentile(map[0], xSize, xSize, ySize, 1.0f - spawnFraction);
+	}
+	else
+	{
+		spawnHeight = ReduceRange(map[0], xSize, xSize, ySize).max - heightFromTop;
+	}
+
+	// If a point in the height map is higher than spawnHeight add it as a vector
+	// This is all the possible river start positions
+	for (int x = 0; x < xSize; x++)
+	{
+		for (int y = 0; y < ySize; y++)
+		{
+			if (map[y][x] > spawnHeight)
+			{
+				Vector2 tempLocation;
+				tempLocation.x = x;
+				tempLocation.y = y;
+
+				highPoints.push_back(tempLocation);
+			}
+		}
+	}
+
+	int rNum = 0;
+	std::vector<Vector2> currentPath;
+
+	// While there is less rivers than alot amount AND ther is still posible spawn locations
+	while (rNum < numberOfRivers && highPoints.size() > 0)
+	{
+		// Randomly choose a starting location, and take it out of the list by moving the last one into its place
+		std::uniform_int_distribution<size_t> distribution(0, highPoints.size() - 1);
+		size_t randomHighPoint = distribution(gen);
+
+		Vector2 startLocation = highPoints[randomHighPoint];
+		highPoints[randomHighPoint] = highPoints.back();
+		highPoints.pop_back();
+
+		// The river map marks every point already on a river, so with betterGen rivers don't start inside another
+		if (betterGen == 1 && riverMap[startLocation.y][startLocation.x] != 0.0f)
+		{
+			continue;
+		}
+
+		currentPath.clear();
+
+		// From the starting location, goes upwards until it can't
+		int xPos = startLocation.x;
+		int yPos = startLocation.y;
+		do
+		{
+			currentPath.push_back(Vector2{ xPos, yPos });
+		}
+		while (StepRiver(filledMap, xSize, ySize, tileable, true, xPos, yPos));
+
+		// From the starting point, travel down the path of least resistance
+		// The pits have been filled, so every cell but the edges and the sea has a lower neighbour
+		xPos = startLocation.x;
+		yPos = startLocation.y;
+		do
+		{
+			currentPath.push_back(Vector2{ xPos, yPos });
+		}
+		while (StepRiver(filledMap, xSize, ySize, tileable, false, xPos, yPos));
+
+		// Checks if the current river is longer than the minimum river length
+		if (currentPath.size() >= minRiverLength)
+		{
+			// Adds the river to the river map
+			for (int i = 0; i < currentPath.size(); i++)
+			{
+				riverMap[currentPath[i].y][currentPath[i].x] = 1.0f;
+			}
+			rNum++;
+		}
+	}
+
+	riversGenerated = rNum;
+
+	DeleteGrid(filledMap);
+
+	return riverMap;
+}
+
+// Generates blurry circles, with a radius of iterations, at each point in the xSize by ySize map that has a value above minValue
+// Only rows firstRow to lastRow - 1 of blur are written, so a map can be blurred a band at a time
+// If tileable is 1 the circles wrap around the edges of the map
+void BlurRows(float** map, float** blur, int xSize, int ySize, int iterations, float minValue, int tileable, int firstRow, int lastRow)
+{
+	float num = 0.0f;
+
+	// Only the points within iterations of the band can reach it
+	for (int yUnwrapped = firstRow - iterations; yUnwrapped < lastRow + iterations; yUnwrapped++)
+	{
+		int y = yUnwrapped;
+
+		// Wraps to the other side of the map
+		if (tileable == 1)
+		{
+			y = ((y % ySize) + ySize) % ySize;
+		}
+		else if (y < 0 || y >= ySize)
+		{
+			continue;
+		}
+
+		for (int x = 0; x < xSize; x++)
+		{
+			if (map[y][x] >= minValue)
+			{
+				// Loops through Moore neighbourhood
+				for (int j = -iterations; j <= iterations; j++)
+				{
+					// Rows outside the band are left to the other bands
+					int yBlur = yUnwrapped + j;
+					if (yBlur < firstRow || yBlur >= lastRow)
+					{
+						continue;
+					}
+
+					for (int i = -iterations; i <= iterations; i++)
+					{
+						int xBlur = x + i;
+
+						// Wraps to the other side of the map
+						if (tileable == 1)
+						{
+							xBlur = (xBlur + xSize) % xSize;
+						}
+
+						// If the neighbour is within the map
+						if (xBlur >= 0 && xBlur < xSize)
+						{
+							num = islandify(x, y, x + i, y + j, iterations);
+							if ((blur[yBlur][xBlur]) < (num - 0.0806051))
+							{
+								blur[yBlur][xBlur] = (num - 0.0806051);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+// Generates blurry circles, with a radius of iterations, at each point in the xSize by ySize map that has a value above minValue
+// If tileable is 1 the circles wrap around the edges of the map
+float** BlurImage(float** map, int xSize, int ySize, int iterations, float minValue, int tileable)
+{
+	// Initilaises blur array
+	float** blur;
+	blur = InitGrid(xSize, ySize);
+
+	// The bands don't write to each other's rows, so they can be blurred at the same time
+	ParallelFor((ySize + bandRows - 1) / bandRows, [&](int band)
+	{
+		BlurRows(map, blur, xSize, ySize, iterations, minValue, tileable, band * bandRows, std::min((band + 1) * bandRows, ySize));
+	});
+
+	return blur;
+}
+
+// Scales a blur radius picked for a 500 pixel map to a size pixel map, so the rivers are the same width on any size of map
+int BlurRadius(float radius, int size)
+{
+	int scaled = (int)(radius * size / 500.0f + 0.5f);
+	if (scaled < 1)
+	{
+		scaled = 1;
+	}
+
+	return scaled;
+}
+
+// The first part of 'blurring' the xSize by ySize river map, blurs it and reduces it by a perlin map so the banks are uneven
+// The result still needs reblurring, with a radius of BlurRadius(10), which can be done a band at a time with BlurRows
+float** RoughenRivers(PerlinNoiseClass& p, float** map, int xSize, int ySize, int tileable)
+{
+	// Initialises the arrays
+	float** blurArray;
+	float** perlinArray;
+	perlinArray = InitGrid(xSize, ySize);
+
+	// The perlin map spans 50 units whatever its size, so it repeats every 50 units when tiling
+	float tileSize = 0.0f;
+	if (tileable == 1)
+	{
+		tileSize = 50.0f;
+	}
+
+	// Creats a perlin map to reduce the river map by
+	ParallelFor(ySize, [&](int y)
+	{
+		for (int x = 0; x < xSize; x++)
+		{
+			perlinArray[y][x] = (FBM(p, x * (50.0f / xSize), y * (50.0f / ySize), 2.0f, 0.8f, 0.8, 2.0, 5, 0, tileSize) + 1) / 2;
+		}
+	});
+
+	// Initial blur
+	blurArray = BlurImage(map, xSize, ySize, BlurRadius(6.0f, xSize), 1.0f, tileable);
+
+	// Scales the perlin map between 0 and 1
+	perlinArray = Scale(perlinArray, xSize, ySize);
+
+	for (int x = 0; x < xSize; x++)
+	{
+		for (int y = 0; y < ySize; y++)
+		{
+			// If there is a river, reduce it by the relative perlin value
+			if (blurArray[y][x] > 0.0f)
+			{
+				blurArray[y][x] -= perlinArray[y][x];
+
+				// Make sure there are no -ve values
+				if (blurArray[y][x] < 0)
+				{
+					blurArray[y][x] = 0.0f;
+				}
+			}
+		}
+	}
+
+	// Scale river map to be between 0 and 1
+	blurArray = Scale(blurArray, xSize, ySize);
+
+	DeleteGrid(perlinArray);
+
+	return blurArray;
+}
+
+// Hashes every field of request, requests with the same hash ask for the same map
+unsigned long long RequestHash(const GenerateRequest& request)
+{
+	unsigned long long hash = hashStart;
+	hash = HashValue(hash, request.size);
+	hash = HashValue(hash, request.seed);
+	hash = HashValue(hash, request.xSeed);
+	hash = HashValue(hash, request.ySeed);
+	hash = HashValue(hash, request.amplitude);
+	hash = HashValue(hash, request.frequency);
+	hash = HashValue(hash, request.persistance);
+	hash = HashValue(hash, request.lacunarity);
+	hash = HashValue(hash, request.octaves);
+	hash = HashValue(hash, request.ridged);
+	hash = HashValue(hash, request.redis);
+	hash = HashValue(hash, request.equalise);
+	hash = HashValue(hash, request.tileable);
+	hash = HashValue(hash, request.warp);
+	hash = HashValue(hash, request.islands);
+	hash = HashValue(hash, request.antiIsland);
+	hash = HashValue(hash, request.islandRange);
+	hash = HashValue(hash, request.droplets);
+	hash = HashValue(hash, request.thermalIterations);
+	hash = HashValue(hash, request.numOfRivers);
+	hash = HashValue(hash, request.minRiverLength);
+	hash = HashValue(hash, request.heightFromTop);
+	hash = HashValue(hash, request.spawnFraction);
+	hash = HashValue(hash, request.betterGen);
+
+	return hash;
+}
+
+// The width and height of the preview of a size pixel map, a quarter of size, but never above 256 so it stays quick
+int PreviewSize(int size)
+{
+	return std::max(1, std::min(size / 4, 256));
+}
+
+// Makes row pointers into view, for the functions that take a float** grid
+std::vector<float*> ViewRows(const TerrainView& view, int ySize)
+{
+	std::vector<float*> rows(ySize);
+	for (int y = 0; y < ySize; y++)
+	{
+		rows[y] = view.data + (size_t)y * view.stride;
+	}
+
+	return rows;
+}
+
+// Initialises the PerlinNoise class of stageCache from seed, keeping it if the seed is the same as last time
+void SeedStages(PipelineCache& stageCache, unsigned int seed)
+{
+	if (stageCache.seeded && stageCache.seed == seed)
+	{
+		return;
+	}
+
+	SeedPerlinTables(seed);
+	stageCache.perlinNoise.init();
+
+	// The first noise call sets the tables up again, so it's done here rather than by whichever band thread is first
+	float first[2] = { 0.0f, 0.0f };
+	stageCache.perlinNoise.noise2(first);
+
+	stageCache.seed = seed;
+	stageCache.seeded = true;
+}
+
+// Frees every stage kept in stageCache
+void ClearStages(PipelineCache& stageCache)
+{
+	ClearStage(stageCache.raw);
+	ClearStage(stageCache.scaled);
+	ClearStage(stageCache.redistributed);
+	ClearStage(stageCache.island);
+	ClearStage(stageCache.eroded);
+	ClearStage(stageCache.thermal);
+	ClearStage(stageCache.rivers);
+	ClearStage(stageCache.blur);
+}
+
+// Runs the stages for request, taking any whose inputs haven't changed from cache
+// The noise is kept on disk if diskCacheBytes is above 0
+GenerateReport RunStages(PipelineCache& cache, const GenerateRequest& request, TerrainBuffers& buffers, unsigned long long diskCacheBytes)
+{
+	GenerateReport report;
+
+	int size = request.size;
+	int bands = (size + bandRows - 1) / bandRows;
+
+	SeedStages(cache, request.seed);
+	PerlinNoiseClass& perlinNoise = cache.perlinNoise;
+
+	// Array of value, each float represents the colour value of a pixel (0 = black, 1 = white)
+	float** perlinArray;
+	float** perlinArraySimple;
+
+	// The map spans 10 units whatever its size, so it repeats every 10 units when tiling
+	float tileSize = 0.0f;
+	if (request.tileable == 1)
+	{
+		tileSize = 10.0f;
+	}
+
+	////// Generates the base and simple height map //////
+	unsigned long long hash = hashStart;
+	hash = HashValue(hash, request.size);
+	hash = HashValue(hash, request.seed);
+	hash = HashValue(hash, request.xSeed);
+	hash = HashValue(hash, request.ySeed);
+	hash = HashValue(hash, request.amplitude);
+	hash = HashValue(hash, request.frequency);
+	hash = HashValue(hash, request.persistance);
+	hash = HashValue(hash, request.lacunarity);
+	hash = HashValue(hash, request.octaves);
+	hash = HashValue(hash, request.ridged);
+	hash = HashValue(hash, tileSize);
+	hash = HashValue(hash, request.warp);
+
+	bool diskCache = diskCacheBytes > 0;
+
+	// The same values, used to find the noise in the disk cache
+	NoiseCacheKey noiseKey;
+	noiseKey.seed = request.seed;
+	noiseKey.xSeed = request.xSeed;
+	noiseKey.ySeed = request.ySeed;
+	noiseKey.amplitude = request.amplitude;
+	noiseKey.frequency = request.frequency;
+	noiseKey.persistance = request.persistance;
+	noiseKey.lacunarity = request.lacunarity;
+	noiseKey.octaves = request.octaves;
+	noiseKey.ridged = request.ridged;
+	noiseKey.tileSize = tileSize;
+	noiseKey.warp = request.warp;
+	noiseKey.size = size;
+
+	MappedGrid mappedNoise;
+
+	if (StageValid(cache.raw, hash))
+	{
+		report.noiseFromMemory = true;
+	}
+	else if (diskCache && LoadCachedNoise(noiseKey, mappedNoise))
+	{
+		report.noiseFromDisk = true;
+		StoreMappedStage(cache.raw, hash, mappedNoise);
+	}
+	else
+	{
+		perlinArray = InitGrid(size, size);
+		perlinArraySimple = InitGrid(size, size);
+
+		// The simple map uses the first half of the same octaves
+		std::vector<Octave> octaveList = SetupOctaves(request.amplitude, request.frequency, request.persistance, request.lacunarity, request.octaves, tileSize);
+
+		// The bands of rows don't depend on each other, so they are all generated at once
+		std::vector<float> bandSeconds(bands, 0.0f);
+
+		ParallelFor(bands, [&](int band)
+		{
+			auto bandStart = std::chrono::steady_clock::now();
+
+			std::vector<float> xs(size);
+			std::vector<float> ys(size);
+
+			for (int y = band * bandRows; y < std::min((band + 1) * bandRows, size); y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					xs[x] = x * (10.0f / size) + request.xSeed;
+					ys[x] = y * (10.0f / size) + request.ySeed;
+				}
+
+				if (request.warp > 0.0f)
+				{
+					WarpedFBMRow(perlinNoise, octaveList, request.octaves, xs.data(), ys.data(), perlinArray[y], size, request.ridged, request.warp);
+					WarpedFBMRow(perlinNoise, octaveList, request.octaves / 2, xs.data(), ys.data(), perlinArraySimple[y], size, request.ridged, request.warp);
+				}
+				else
+				{
+					FBMRow(perlinNoise, octaveList, request.octaves, xs.data(), ys.data(), perlinArray[y], size, request.ridged);
+					FBMRow(perlinNoise, octaveList, request.octaves / 2, xs.data(), ys.data(), perlinArraySimple[y], size, request.ridged);
+				}
+			}
+
+			std::chrono::duration<float> bandTime = std::chrono::steady_clock::now() - bandStart;
+			bandSeconds[band] = bandTime.count();
+		});
+
+		// Works out how much the warp costs, by timing plain FBM over every 10th row
+		// The bands ran at the same time, so it is compared against the time each band took added up
+		if (request.warp > 0.0f)
+		{
+			float warpTime = 0.0f;
+			for (int band = 0; band < bands; band++)
+			{
+				warpTime += bandSeconds[band];
+			}
+
+			auto plainStart = std::chrono::steady_clock::now();
+
+			std::vector<float> xs(size);
+			std::vector<float> ys(size);
+			std::vector<float> plainRow(size);
+			for (int y = 0; y < size; y += 10)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					xs[x] = x * (10.0f / size) + request.xSeed;
+					ys[x] = y * (10.0f / size) + request.ySeed;
+				}
+
+				FBMRow(perlinNoise, octaveList, request.octaves, xs.data(), ys.data(), plainRow.data(), size, request.ridged);
+				FBMRow(perlinNoise, octaveList, request.octaves / 2, xs.data(), ys.data(), plainRow.data(), size, request.ridged);
+			}
+
+			std::chrono::duration<float> plainTime = std::chrono::steady_clock::now() - plainStart;
+			if (plainTime.count() > 0.0f)
+			{
+				report.warpCost = warpTime / (plainTime.count() * 10);
+			}
+		}
+
+		StoreStage(cache.raw, hash, perlinArray, perlinArraySimple);
+
+		// Saves the noise for later runs, keeping the cache under its size limit
+		if (diskCache)
+		{
+			SaveCachedNoise(noiseKey, perlinArray, perlinArraySimple);
+			EvictCachedNoise(diskCacheBytes);
+		}
+	}
+
+	////// Scales, redistributes and generates the island //////
+	// Each of these only needs the same rows of the stage before, so each band of rows is taken through all of them
+	// in one go, spread over the cores, while the band is still in the cache
+	unsigned long long scaledHash = hash;
+	unsigned long long redistributedHash = HashValue(scaledHash, request.redis);
+	redistributedHash = HashValue(redistributedHash, request.equalise);
+	hash = HashValue(redistributedHash, request.islands);
+	hash = HashValue(hash, request.antiIsland);
+	hash = HashValue(hash, request.islandRange);
+	unsigned long long islandHash = hash;
+
+	bool scaleStale = !StageValid(cache.scaled, scaledHash);
+	bool redistributeStale = !StageValid(cache.redistributed, redistributedHash);
+	bool islandStale = !StageValid(cache.island, islandHash);
+
+	// The stages being regenerated are written to new grids, which replace the cached ones once the pipeline is done
+	float** raw = cache.raw.grid;
+	float** rawSimple = cache.raw.gridSimple;
+	float** scaled = scaleStale ? InitGrid(size, size) : cache.scaled.grid;
+	float** scaledSimple = scaleStale ? InitGrid(size, size) : cache.scaled.gridSimple;
+	float** redistributed = redistributeStale ? InitGrid(size, size) : cache.redistributed.grid;
+	float** redistributedSimple = redistributeStale ? InitGrid(size, size) : cache.redistributed.gridSimple;
+	float** island = islandStale ? InitGrid(size, size) : cache.island.grid;
+	float** islandSimple = islandStale ? InitGrid(size, size) : cache.island.gridSimple;
+
+	std::vector<std::function<void(int)>> stages;
+
+	HeightRange range;
+	HeightRange rangeSimple;
+
+	if (scaleStale)
+	{
+		// Scales the height between 0 and 1
+		range = ReduceRange(raw[0], size, size, size);
+		rangeSimple = ReduceRange(rawSimple[0], size, size, size);
+
+		float min = range.min;
+		float max = range.max;
+		float minSimple = rangeSimple.min;
+		float maxSimple = rangeSimple.max;
+
+		stages.push_back([=](int band)
+		{
+			for (int y = band * bandRows; y < std::min((band + 1) * bandRows, size); y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					scaled[y][x] = ScaleHeight(raw[y][x], min, max);
+					scaledSimple[y][x] = ScaleHeight(rawSimple[y][x], minSimple, maxSimple);
+				}
+			}
+		});
+	}
+
+	if (redistributeStale)
+	{
+		// Redistribution
+		// The scaled heights go from exactly 0 to exactly 1, which equalising and pow leave where they are, so they
+		// don't need scaling again
+		float redis = request.redis;
+		bool equalise = request.equalise == 1;
+
+		// Equalising flattens the heights so there's as much of the map at each height, before redis curves them
+		// It needs the whole scaled map counted first. Counting the raw map from its min to max puts every point in
+		// the same bin as counting the scaled map from 0 to 1, so it doesn't have to wait for the scaling
+		std::vector<float> curve;
+		std::vector<float> curveSimple;
+		if (equalise)
+		{
+			std::vector<unsigned int> histogram(equaliseBins);
+			std::vector<unsigned int> histogramSimple(equaliseBins);
+
+			if (scaleStale)
+			{
+				ReduceHistogram(raw[0], size, size, size, range.min, range.max, histogram);
+				ReduceHistogram(rawSimple[0], size, size, size, rangeSimple.min, rangeSimple.max, histogramSimple);
+			}
+			else
+			{
+				ReduceHistogram(scaled[0], size, size, size, 0.0f, 1.0f, histogram);
+				ReduceHistogram(scaledSimple[0], size, size, size, 0.0f, 1.0f, histogramSimple);
+			}
+
+			curve = EqualiseCurve(histogram);
+			curveSimple = EqualiseCurve(histogramSimple);
+		}
+
+		stages.push_back([=](int band)
+		{
+			for (int y = band * bandRows; y < std::min((band + 1) * bandRows, size); y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					if (equalise)
+					{
+						redistributed[y][x] = pow(EqualiseHeight(curve, scaled[y][x]), redis);
+						redistributedSimple[y][x] = pow(EqualiseHeight(curveSimple, scaledSimple[y][x]), redis);
+					}
+					else
+					{
+						redistributed[y][x] = pow(scaled[y][x], redis);
+						redistributedSimple[y][x] = pow(scaledSimple[y][x], redis);
+					}
+				}
+			}
+		});
+	}
+
+	if (islandStale)
+	{
+		// The island is centred on the map, and is the same size relative to the map whatever its size
+		float centre = size / 2.0f;
+		float islandRange = request.islandRange * size / 500.0f;
+		int islands = request.islands;
+		int antiIsland = request.antiIsland;
+
+		stages.push_back([=](int band)
+		{
+			for (int y = band * bandRows; y < std::min((band + 1) * bandRows, size); y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					float islandValue = 1.0f;
+					if (islands == 1)
+					{
+						islandValue = islandify(centre, centre, (float)x, (float)y, islandRange);
+
+						// User want inverted island
+						if (antiIsland == 1)
+						{
+							islandValue = 1 - islandValue;
+						}
+					}
+
+					island[y][x] = redistributed[y][x] * islandValue;
+					islandSimple[y][x] = redistributedSimple[y][x] * islandValue;
+				}
+			}
+		});
+	}
+
+	ParallelFor(bands, [&](int band)
+	{
+		for (int s = 0; s < stages.size(); s++)
+		{
+			stages[s](band);
+		}
+	});
+
+	if (scaleStale)
+	{
+		StoreStage(cache.scaled, scaledHash, scaled, scaledSimple);
+	}
+	if (redistributeStale)
+	{
+		StoreStage(cache.redistributed, redistributedHash, redistributed, redistributedSimple);
+	}
+	if (islandStale)
+	{
+		StoreStage(cache.island, islandHash, island, islandSimple);
+	}
+
+	////// Erodes the map //////
+	hash = HashValue(hash, request.droplets);
+
+	if (!StageValid(cache.eroded, hash))
+	{
+		perlinArray = CopyGrid(cache.island.grid, size, size);
+		perlinArraySimple = CopyGrid(cache.island.gridSimple, size, size);
+
+		if (request.droplets > 0)
+		{
+			// Seeded from the map, so the same map is always eroded the same way
+			ErosionSettings erosion;
+			erosion.droplets = request.droplets;
+			erosion.seed = request.seed;
+			erosion.tileable = request.tileable;
+
+			auto erosionStart = std::chrono::steady_clock::now();
+
+			// The simple map is eroded too, so the rivers follow the eroded valleys
+			HydraulicErosion(perlinArray, size, size, erosion);
+			HydraulicErosion(perlinArraySimple, size, size, erosion);
+
+			std::chrono::duration<float> erosionTime = std::chrono::steady_clock::now() - erosionStart;
+			if (erosionTime.count() > 0.0f)
+			{
+				report.dropletsPerSecond = (request.droplets * 2) / erosionTime.count();
+			}
+		}
+
+		StoreStage(cache.eroded, hash, perlinArray, perlinArraySimple);
+	}
+
+	////// Smooths the cliffs //////
+	hash = HashValue(hash, request.thermalIterations);
+
+	if (!StageValid(cache.thermal, hash))
+	{
+		perlinArray = CopyGrid(cache.eroded.grid, size, size);
+		perlinArraySimple = CopyGrid(cache.eroded.gridSimple, size, size);
+
+		if (request.thermalIterations > 0)
+		{
+			ThermalSettings thermal;
+			thermal.iterations = request.thermalIterations;
+			thermal.tileable = request.tileable;
+
+			ThermalErosion(perlinArray, size, size, thermal);
+			ThermalErosion(perlinArraySimple, size, size, thermal);
+		}
+
+		StoreStage(cache.thermal, hash, perlinArray, perlinArraySimple);
+	}
+
+	perlinArray = cache.thermal.grid;
+	perlinArraySimple = cache.thermal.gridSimple;
+
+	////// River generation //////
+	// Generates the river map, if there are no rivers it is just a blank map
+	hash = HashValue(hash, request.numOfRivers);
+	hash = HashValue(hash, request.minRiverLength);
+	hash = HashValue(hash, request.heightFromTop);
+	hash = HashValue(hash, request.spawnFraction);
+	hash = HashValue(hash, request.betterGen);
+	hash = HashValue(hash, request.tileable);
+
+	if (!StageValid(cache.rivers, hash))
+	{
+		float** riverArray = GenerateRivers(perlinArraySimple, size, size, request.numOfRivers, request.minRiverLength, request.heightFromTop, request.spawnFraction, request.betterGen, request.tileable, cache.riversGenerated);
+		StoreStage(cache.rivers, hash, riverArray, nullptr);
+	}
+	report.riversGenerated = cache.riversGenerated;
+
+	////// Blurs the river map, and writes the results to the caller's buffers //////
+	// Each band is reblurred and written out in one go, spread over the cores, and handed to bandReady in order as soon
+	// as it and every band before it are written, while later ones are still being blurred
+	// This is the only stage that streams, everything before it (noise, min and max, erosion, rivers) needs the whole map
+	bool blurStale = !StageValid(cache.blur, hash);
+	float** roughArray = nullptr;
+	float** riverArrayBlur = cache.blur.grid;
+
+	if (blurStale)
+	{
+		riverArrayBlur = InitGrid(size, size);
+
+		// Without any rivers the blurred map is blank, so there's nothing to blur
+		if (cache.riversGenerated > 0)
+		{
+			roughArray = RoughenRivers(perlinNoise, cache.rivers.grid, size, size, request.tileable);
+		}
+	}
+
+	stages.clear();
+
+	int radius = BlurRadius(10.0f, size);
+
+	stages.push_back([&](int band)
+	{
+		// Reblur the river map
+		if (roughArray != nullptr)
+		{
+			BlurRows(roughArray, riverArrayBlur, size, size, radius, 0.14f, request.tileable, band * bandRows, std::min((band + 1) * bandRows, size));
+		}
+
+		for (int y = band * bandRows; y < std::min((band + 1) * bandRows, size); y++)
+		{
+			if (buffers.rivers.data != nullptr)
+			{
+				memcpy(buffers.rivers.data + (size_t)y * buffers.rivers.stride, riverArrayBlur[y], size * sizeof(float));
+			}
+
+			if (buffers.heights.data != nullptr)
+			{
+				float* heights = buffers.heights.data + (size_t)y * buffers.heights.stride;
+
+				for (int x = 0; x < size; x++)
+				{
+					// If there is a river, reduce the height map
+					float num = perlinArray[y][x];
+					if (riverArrayBlur[y][x] != 0.0f)
+					{
+						num -= riverArrayBlur[y][x] / 10.0f;
+						if (num < 0)
+						{
+							num = 0;
+						}
+					}
+
+					heights[x] = num;
+				}
+			}
+		}
+	});
+
+	if (buffers.bandReady)
+	{
+		stages.push_back([&](int band)
+		{
+			int firstRow = band * bandRows;
+			buffers.bandReady(firstRow, std::min(bandRows, size - firstRow));
+		});
+	}
+
+	RunBandPipeline(bands, stages);
+
+	if (blurStale)
+	{
+		StoreStage(cache.blur, hash, riverArrayBlur, nullptr);
+	}
+	if (roughArray != nullptr)
+	{
+		DeleteGrid(roughArray);
+	}
+
+	return report;
+}
+
+// Everything a generator keeps between calls
+struct TerrainGenerator::Stages
+{
+	PipelineCache cache;
+	PipelineCache previewCache;
+};
+
+TerrainGenerator::TerrainGenerator() : stages(new Stages())
+{
+}
+
+TerrainGenerator::~TerrainGenerator()
+{
+	FreeStages();
+}
+
+void TerrainGenerator::FreeStages()
+{
+	ClearStages(stages->cache);
+	ClearStages(stages->previewCache);
+}
+
+// Generate the height map
+// Stages whose inputs haven't changed since the last call are taken from cache instead of being regenerated
+GenerateReport TerrainGenerator::Generate(const GenerateRequest& request, TerrainBuffers& buffers)
+{
+	return RunStages(stages->cache, request, buffers, diskCacheBytes);
+}
+
+// Generate a small version of the map, without the slow stages
+GenerateReport TerrainGenerator::Preview(const GenerateRequest& request, TerrainBuffers& buffers)
+{
+	GenerateRequest previewRequest = request;
+	previewRequest.size = PreviewSize(request.size);
+	previewRequest.droplets = 0;
+	previewRequest.thermalIterations = 0;
+	previewRequest.numOfRivers = 0;
+
+	return RunStages(stages->previewCache, previewRequest, buffers, 0);
+}
+
+// Generates a single map, without keeping anything for next time
+GenerateReport GenerateTerrain(const GenerateRequest& request, TerrainBuffers& buffers)
+{
+	TerrainGenerator generator;
+	return generator.Generate(request, buffers);
+}
@@ -0,0 +1,152 @@
+/*
+	Terrain generation library
+
+	Everything needed to generate a height map and river map, without any console input or image
+	saving, so it can be built on its own and used by other programs. The library is Terrain.cpp,
+	Erosion.cpp, Reductions.cpp, NoiseCache.cpp and PerlinNoiseClass.cpp, and this is the only header
+	a program using it needs.
+	Fill in a GenerateRequest, point a TerrainBuffers at memory you own, and call Generate. The
+	results are written straight into your buffers, so the same buffers can be reused every call.
+
+	A TerrainGenerator keeps each stage of the last map it made, so a request that only changes
+	later stages (the island, erosion, rivers...) only reruns those stages.
+
+	For tuning values by eye, Preview makes a small version of the map in a few milliseconds. The
+	full map from Generate is the same whether or not there was a preview first.
+*/
+
+#ifndef _TERRAIN_H_
+#define _TERRAIN_H_
+
+#include <vector>
+#include <functional>
+#include <memory>
+
+// Everything that changes a generated map, the defaults are the console program's default values
+struct GenerateRequest
+{
+	// The map is size by size pixels, and always covers the same area whatever its size
+	int size = 500;
+
+	unsigned int seed = 0;
+	float xSeed = 0.0f;
+	float ySeed = 0.0f;
+
+	// Noise
+	float amplitude = 2.0f;
+	float frequency = 0.5f;
+	float persistance = 0.5f;
+	float lacunarity = 2.0f;
+	int octaves = 5;
+	int ridged = 0;
+	float redis = 0.7f;
+	int tileable = 0;
+	float warp = 0.0f;
+
+	// 1 flattens the heights with histogram equalisation, so there's as much of the map at each height, before redis
+	int equalise = 0;
+
+	// Island, islandRange is in pixels on a 500 pixel map, and scales with size
+	int islands = 0;
+	int antiIsland = 0;
+	float islandRange = 250.0f;
+
+	// Erosion
+	int droplets = 0;
+	int thermalIterations = 0;
+
+	// Rivers
+	int numOfRivers = 0;
+	int minRiverLength = 0;
+	float heightFromTop = 0.0f;
+	int betterGen = 0;
+
+	// If above 0, rivers start from this fraction of the map with the highest points, instead of using heightFromTop
+	float spawnFraction = 0.0f;
+};
+
+// A block of floats owned by the caller, row y starts at data + y * stride
+struct TerrainView
+{
+	float* data = nullptr;
+	int stride = 0;
+};
+
+// Where Generate writes its results, each size by size
+// heights is the height map with the rivers carved in, rivers is the blurred river map, both from 0 to 1
+// Leave a view's data as nullptr to skip it
+struct TerrainBuffers
+{
+	TerrainView heights;
+	TerrainView rivers;
+
+	// If set, called with each band of rows, in order, as soon as it and the bands before it are written
+	// The noise, the min and max, erosion and rivers each need the whole map, so bands only start coming once the rivers
+	// are done, it's just the river blur and writing out that overlap with bandReady, not the whole generation
+	// It may be called from another thread, but never from two at once
+	std::function<void(int firstRow, int rowCount)> bandReady;
+};
+
+// What happened while generating, for the caller to report
+struct GenerateReport
+{
+	bool noiseFromMemory = false;
+	bool noiseFromDisk = false;
+
+	// How many times longer the domain warped noise took than plain FBM, 0 if it wasn't warped
+	float warpCost = 0.0f;
+
+	// 0 if there was no erosion
+	float dropletsPerSecond = 0.0f;
+
+	int riversGenerated = 0;
+};
+
+// Generates maps, keeping the stages of the last one
+// A generator can only be used by one thread at a time, use one generator per thread
+class TerrainGenerator
+{
+public:
+	TerrainGenerator();
+	~TerrainGenerator();
+
+	// Generates the map for request into buffers
+	GenerateReport Generate(const GenerateRequest& request, TerrainBuffers& buffers);
+
+	// Generates a preview of request into buffers, PreviewSize(request.size) pixels across
+	// It covers the same area with the same noise, redistribution and island, but without erosion or rivers
+	// bandReady is called with the preview's rows
+	GenerateReport Preview(const GenerateRequest& request, TerrainBuffers& buffers);
+
+	// Frees the stages kept from the last map and preview, about 56 bytes a pixel of the last map
+	// The next Generate starts from scratch, apart from the noise tables
+	void FreeStages();
+
+	// The most the on-disk noise cache can hold, 0 turns the disk cache off
+	unsigned long long diskCacheBytes = 0;
+
+private:
+	// The stages of the last map and preview, see Terrain.cpp
+	struct Stages;
+	std::unique_ptr<Stages> stages;
+};
+
+// Generates a single map, without keeping anything for next time
+GenerateReport GenerateTerrain(const GenerateRequest& request, TerrainBuffers& buffers);
+
+// The width and height of the preview of a size pixel map, a quarter of size, but never above 256 so it stays quick
+int PreviewSize(int size);
+
+// Hashes every field of request, requests with the same hash ask for the same map
+unsigned long long RequestHash(const GenerateRequest& request);
+
+// Initialises a float** array to xSize by ySize, and sets all values to 0.0f
+float** InitGrid(int xSize, int ySize);
+
+// Deletes a float** array made by InitGrid
+void DeleteGrid(float** grid);
+
+// Makes row pointers into view, for the functions that take a float** grid
+std::vector<float*> ViewRows(const TerrainView& view, int ySize);
+
+#endif
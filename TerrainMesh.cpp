@@ -0,0 +1,294 @@
+#include "TerrainMesh.h"
+#include "Parallel.h"
+#include <math.h>
+#include <fstream>
+
+float SampleMap(float** map, int xSize, int ySize, float u, float v)
+{
+	float x = u * (xSize - 1);
+	float y = v * (ySize - 1);
+
+	if (x < 0) x = 0;
+	if (y < 0) y = 0;
+	if (x > xSize - 1) x = (float)(xSize - 1);
+	if (y > ySize - 1) y = (float)(ySize - 1);
+
+	int x0 = (int)x;
+	int y0 = (int)y;
+	int x1 = (x0 + 1 < xSize) ? x0 + 1 : x0;
+	int y1 = (y0 + 1 < ySize) ? y0 + 1 : y0;
+	float fx = x - x0;
+	float fy = y - y0;
+
+	float top = map[y0][x0] + (map[y0][x1] - map[y0][x0]) * fx;
+	float bottom = map[y1][x0] + (map[y1][x1] - map[y1][x0]) * fx;
+
+	return top + (bottom - top) * fy;
+}
+
+// Matches CalculateDistance in tessellation_hs.hlsl, the closer the point is to the camera the higher the factor
+static float CalculateFactor(float** map, int xSize, int ySize, const TessellationSettings& s, float x, float z, float u, float v)
+{
+	float y = SampleMap(map, xSize, ySize, u, v) * s.heightScale;
+
+	float dX = s.cameraX - x;
+	float dY = s.cameraY - y;
+	float dZ = s.cameraZ - z;
+
+	float distance = 64 - sqrtf(dX * dX + dY * dY + dZ * dZ) * 4;
+
+	if (distance > 64)
+	{
+		distance = 64;
+	}
+	else if (distance < 2)
+	{
+		distance = 2;
+	}
+
+	return distance;
+}
+
+// CalculateFactor at a point on a lattice of half patches over the whole map, like AddVertex the position comes from the
+// integer index, so a point on an edge works out bit for bit the same from both patches either side of it
+static float CalculateHalfPatchFactor(float** map, int xSize, int ySize, const TessellationSettings& s, int halfX, int halfZ)
+{
+	// How many patches across the map the point is
+	float mapU = halfX / 2.0f;
+	float mapV = halfZ / 2.0f;
+
+	return CalculateFactor(map, xSize, ySize, s, mapU * s.patchSize, mapV * s.patchSize, mapU / s.patches, mapV / s.patches);
+}
+
+PatchFactors CalculatePatchFactors(float** map, int xSize, int ySize, int patchX, int patchY, const TessellationSettings& settings)
+{
+	PatchFactors factors;
+
+	// Edge midpoints in half patches from the patch's corner, u runs along x and v runs along z
+	int edgeU[4] = { 0, 1, 2, 1 };
+	int edgeV[4] = { 1, 0, 1, 2 };
+
+	for (int i = 0; i < 4; i++)
+	{
+		factors.edges[i] = CalculateHalfPatchFactor(map, xSize, ySize, settings, patchX * 2 + edgeU[i], patchY * 2 + edgeV[i]);
+	}
+
+	factors.inside = CalculateHalfPatchFactor(map, xSize, ySize, settings, patchX * 2 + 1, patchY * 2 + 1);
+
+	return factors;
+}
+
+// fractional_even partitioning, a whole mesh can't morph between levels so the factor is rounded up to the next even number
+static int EvenLevel(float factor)
+{
+	return 2 * (int)ceilf(factor / 2.0f);
+}
+
+// Builds one patch's mesh, uv coordinates are within the patch
+class PatchBuilder
+{
+public:
+	PatchBuilder(float** map, int xSize, int ySize, int patchX, int patchY, const TessellationSettings& s, PatchMesh& mesh)
+		: map(map), xSize(xSize), ySize(ySize), patchX(patchX), patchY(patchY), s(s), mesh(mesh)
+	{
+	}
+
+	// Adds the vertex i / iSteps of the way along u and j / jSteps along v, displaced like tessellation_ds.hlsl, and
+	// returns its index
+	// The position comes from the vertex's index on a lattice over the whole map, so a vertex on an edge or corner
+	// works out bit for bit the same in every patch that shares it
+	int AddVertex(int i, int iSteps, int j, int jSteps)
+	{
+		// How many patches across the map the vertex is
+		float mapU = (float)(patchX * iSteps + i) / iSteps;
+		float mapV = (float)(patchY * jSteps + j) / jSteps;
+
+		float height = SampleMap(map, xSize, ySize, mapU / s.patches, mapV / s.patches);
+
+		if (height < s.waterLevel)
+		{
+			height = s.waterLevel;
+		}
+
+		mesh.vertices.push_back(mapU * s.patchSize);
+		mesh.vertices.push_back((height - s.waterLevel) * s.heightScale);
+		mesh.vertices.push_back(mapV * s.patchSize);
+
+		uvs.push_back((float)i / iSteps);
+		uvs.push_back((float)j / jSteps);
+
+		return (int)uvs.size() / 2 - 1;
+	}
+
+	// Adds a triangle, wound clockwise when looked at from above to match triangle_cw
+	void AddTriangle(int a, int b, int c)
+	{
+		float area = (uvs[b * 2] - uvs[a * 2]) * (uvs[c * 2 + 1] - uvs[a * 2 + 1]) - (uvs[b * 2 + 1] - uvs[a * 2 + 1]) * (uvs[c * 2] - uvs[a * 2]);
+
+		mesh.indices.push_back((unsigned short)a);
+		if (area > 0)
+		{
+			mesh.indices.push_back((unsigned short)c);
+			mesh.indices.push_back((unsigned short)b);
+		}
+		else
+		{
+			mesh.indices.push_back((unsigned short)b);
+			mesh.indices.push_back((unsigned short)c);
+		}
+	}
+
+	// Joins two rows of vertices, both running the same way along the side, with a strip of triangles
+	void Stitch(const std::vector<int>& outer, const std::vector<float>& outerT, const std::vector<int>& inner, const std::vector<float>& innerT)
+	{
+		int i = 0;
+		int j = 0;
+		int outerLast = (int)outer.size() - 1;
+		int innerLast = (int)inner.size() - 1;
+
+		// Steps along whichever row has the closer next vertex
+		while (i < outerLast || j < innerLast)
+		{
+			if (j == innerLast || (i < outerLast && outerT[i + 1] <= innerT[j + 1]))
+			{
+				AddTriangle(outer[i], outer[i + 1], inner[j]);
+				i++;
+			}
+			else
+			{
+				AddTriangle(outer[i], inner[j + 1], inner[j]);
+				j++;
+			}
+		}
+	}
+
+private:
+	float** map;
+	int xSize;
+	int ySize;
+	int patchX;
+	int patchY;
+	const TessellationSettings& s;
+	PatchMesh& mesh;
+
+	std::vector<float> uvs;
+};
+
+// Tessellates a single patch, the inside is a regular grid and each edge is stitched to it at its own factor
+static void TessellatePatch(float** map, int xSize, int ySize, int patchX, int patchY, const TessellationSettings& settings, PatchMesh& mesh)
+{
+	PatchFactors factors = CalculatePatchFactors(map, xSize, ySize, patchX, patchY, settings);
+	PatchBuilder builder(map, xSize, ySize, patchX, patchY, settings, mesh);
+
+	int inside = EvenLevel(factors.inside);
+	int innerCount = inside - 1;
+
+	// The inner grid, from 1 / inside to (inside - 1) / inside along u and v
+	std::vector<int> grid(innerCount * innerCount);
+	for (int j = 0; j < innerCount; j++)
+	{
+		for (int i = 0; i < innerCount; i++)
+		{
+			grid[j * innerCount + i] = builder.AddVertex(i + 1, inside, j + 1, inside);
+		}
+	}
+
+	for (int j = 0; j + 1 < innerCount; j++)
+	{
+		for (int i = 0; i + 1 < innerCount; i++)
+		{
+			int a = grid[j * innerCount + i];
+			int b = grid[j * innerCount + i + 1];
+			int c = grid[(j + 1) * innerCount + i];
+			int d = grid[(j + 1) * innerCount + i + 1];
+
+			builder.AddTriangle(a, b, c);
+			builder.AddTriangle(b, d, c);
+		}
+	}
+
+	// Corners, shared by the two edges that meet there
+	int corners[4];
+	corners[0] = builder.AddVertex(0, 1, 0, 1);
+	corners[1] = builder.AddVertex(1, 1, 0, 1);
+	corners[2] = builder.AddVertex(0, 1, 1, 1);
+	corners[3] = builder.AddVertex(1, 1, 1, 1);
+
+	// For each edge, which corners it goes between, and whether it runs along u or v
+	int edgeStart[4] = { 0, 0, 1, 2 };
+	int edgeEnd[4] = { 2, 1, 3, 3 };
+	bool alongU[4] = { false, true, false, true };
+	int fixed[4] = { 0, 0, 1, 1 };
+
+	for (int e = 0; e < 4; e++)
+	{
+		int level = EvenLevel(factors.edges[e]);
+
+		// The edge's vertices, evenly spaced at its own level
+		std::vector<int> outer;
+		std::vector<float> outerT;
+		outer.push_back(corners[edgeStart[e]]);
+		outerT.push_back(0.0f);
+		for (int k = 1; k < level; k++)
+		{
+			float t = (float)k / level;
+			outer.push_back(alongU[e] ? builder.AddVertex(k, level, fixed[e], 1) : builder.AddVertex(fixed[e], 1, k, level));
+			outerT.push_back(t);
+		}
+		outer.push_back(corners[edgeEnd[e]]);
+		outerT.push_back(1.0f);
+
+		// The side of the inner grid next to this edge
+		std::vector<int> inner;
+		std::vector<float> innerT;
+		int fixedIndex = (fixed[e] == 0) ? 0 : innerCount - 1;
+		for (int k = 0; k < innerCount; k++)
+		{
+			inner.push_back(alongU[e] ? grid[fixedIndex * innerCount + k] : grid[k * innerCount + fixedIndex]);
+			innerT.push_back((float)(k + 1) / inside);
+		}
+
+		builder.Stitch(outer, outerT, inner, innerT);
+	}
+}
+
+std::vector<PatchMesh> TessellateTerrain(float** map, int xSize, int ySize, const TessellationSettings& settings)
+{
+	std::vector<PatchMesh> patches(settings.patches * settings.patches);
+
+	ParallelFor(patches.size(), [&](int i)
+	{
+		TessellatePatch(map, xSize, ySize, i % settings.patches, i / settings.patches, settings, patches[i]);
+	});
+
+	return patches;
+}
+
+bool SaveTerrainMesh(const char* fileName, const std::vector<PatchMesh>& patches)
+{
+	std::ofstream file(fileName, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	unsigned int version = 1;
+	unsigned int patchCount = (unsigned int)patches.size();
+
+	file.write("TMSH", 4);
+	file.write((const char*)&version, sizeof(version));
+	file.write((const char*)&patchCount, sizeof(patchCount));
+
+	for (int i = 0; i < patches.size(); i++)
+	{
+		unsigned int vertexCount = (unsigned int)patches[i].vertices.size() / 3;
+		unsigned int indexCount = (unsigned int)patches[i].indices.size();
+
+		file.write((const char*)&vertexCount, sizeof(vertexCount));
+		file.write((const char*)&indexCount, sizeof(indexCount));
+		file.write((const char*)patches[i].vertices.data(), patches[i].vertices.size() * sizeof(float));
+		file.write((const char*)patches[i].indices.data(), patches[i].indices.size() * sizeof(unsigned short));
+	}
+
+	return file.good();
+}
@@ -0,0 +1,62 @@
+/*
+	CPU version of the tessellation shaders, for exporting meshes without a GPU
+
+	Splits the height map into a grid of quad patches and works out each patch's edge and inside
+	tessellation factors the same way PatchConstantFunction in tessellation_hs.hlsl does, from the
+	camera's distance to the edge midpoints and the patch middle. Each patch is then tessellated
+	and displaced like tessellation_ds.hlsl, into its own indexed vertex and index buffers.
+
+	Neighbouring patches work out a shared edge's factor from the same midpoint, and the edge
+	vertices only depend on that factor, so the patches meet without cracks.
+*/
+
+#ifndef _TERRAINMESH_H_
+#define _TERRAINMESH_H_
+
+#include <vector>
+
+// The values the shaders get from their constant buffers
+struct TessellationSettings
+{
+	float cameraX = 0.0f;
+	float cameraY = 10.0f;
+	float cameraZ = 0.0f;
+
+	float heightScale = 10.0f;
+	float waterLevel = 0.0f;
+
+	// How many patches along each side of the map, and how big each one is in world units
+	int patches = 32;
+	float patchSize = 2.0f;
+};
+
+// The tessellation factors for a quad patch, in the same order as SV_TessFactor
+// edges[0] is the u = 0 edge, edges[1] is v = 0, edges[2] is u = 1 and edges[3] is v = 1
+struct PatchFactors
+{
+	float edges[4];
+	float inside;
+};
+
+// A tessellated patch, vertices holds x, y, z for each vertex
+struct PatchMesh
+{
+	std::vector<float> vertices;
+	std::vector<unsigned short> indices;
+};
+
+// Bilinearly samples map at texture coordinate (u, v), clamping at the edges
+float SampleMap(float** map, int xSize, int ySize, float u, float v);
+
+// Works out the tessellation factors for the patch at (patchX, patchY), matching PatchConstantFunction
+PatchFactors CalculatePatchFactors(float** map, int xSize, int ySize, int patchX, int patchY, const TessellationSettings& settings);
+
+// Tessellates every patch of the map, one patch per thread at a time
+std::vector<PatchMesh> TessellateTerrain(float** map, int xSize, int ySize, const TessellationSettings& settings);
+
+// Writes the patches to fileName, returns false if the file couldn't be written
+// The file is "TMSH", a version number and the patch count, then for each patch its vertex count and index count,
+// its vertices as 3 floats each and its indices as 16 bit unsigned ints, all little endian
+bool SaveTerrainMesh(const char* fileName, const std::vector<PatchMesh>& patches);
+
+#endif